@@ -23,7 +23,23 @@ done
 
 LOG_PATH=$2
 echo ${@:3}
-mpirun --map-by ppr:1:node --bind-to none --mca btl ^usnic -v --report-bindings --host $1 --nolocal ${@:3} &
+
+# Placement of the ranks (platform.powergraph.placement): "node" starts one
+# unbound rank per node, "numa" starts one rank per socket, bound to the cores
+# of that socket. Only the ranks are bound, their memory is placed by the
+# default policy of the kernel, normally on the NUMA node of the socket.
+PLACEMENT=${POWERGRAPH_PLACEMENT:-node}
+SOCKETS=${POWERGRAPH_SOCKETS_PER_NODE:-2}
+
+if [ "$PLACEMENT" = "numa" ]; then
+  HOSTS=`echo $1 | sed "s/\([^,]*\)/\1:$SOCKETS/g"`
+  MAPPING="--map-by ppr:1:socket --bind-to socket -x OMP_PROC_BIND=close -x OMP_PLACES=cores"
+else
+  HOSTS=$1
+  MAPPING="--map-by ppr:1:node --bind-to none"
+fi
+
+mpirun $MAPPING --mca btl ^usnic -v --report-bindings --host $HOSTS --nolocal ${@:3} &
 
 echo $! > $LOG_PATH/executable.pid
 wait $!
@@ -0,0 +1,59 @@
+#!/usr/bin/env python3
+#
+# Copyright 2015 Delft University of Technology
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#         http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+#
+
+# Stand-in for the Granula monitor, to measure the overhead of the monitoring
+# messages sent by the Granula build of the binary (bin/granula/main) without
+# a real monitor. Accepts connections on the monitor port (one per message)
+# and prints every message it receives.
+#
+# usage: granula-monitor-standin.py [port]
+
+import socket
+import sys
+import threading
+import time
+
+
+def serve(conn, addr):
+    start = time.time()
+    count = 0
+
+    with conn, conn.makefile("r") as lines:
+        for line in lines:
+            count += 1
+            print("%s: %s" % (addr[0], line.rstrip("\n")), flush=True)
+
+    print("%s: %d messages in %.3f sec" % (addr[0], count, time.time() - start), flush=True)
+
+
+def main():
+    port = int(sys.argv[1]) if len(sys.argv) > 1 else 2656
+
+    server = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+    server.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+    server.bind(("localhost", port))
+    server.listen(16)
+
+    print("Listening on port %d" % port, flush=True)
+
+    while True:
+        conn, addr = server.accept()
+        threading.Thread(target=serve, args=(conn, addr), daemon=True).start()
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,223 @@
+#
+# Copyright 2015 Delft University of Technology
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#         http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+#
+
+# Shared code of the benchmark harnesses: generates graphs with the generate
+# binary, runs the main binary on a single machine (directly or through a
+# local mpirun) and parses the JSON records it writes to stderr.
+
+import glob
+import json
+import os
+import shlex
+import statistics
+import subprocess
+import time
+
+ALGORITHMS = ["bfs", "wcc", "pr", "cdlp", "lcc", "sssp"]
+
+MAX_ITERATIONS = 10
+DAMPING_FACTOR = 0.85
+
+
+class Graph:
+    def __init__(self, name, prefix, directed):
+        self.name = name
+        self.vertex_file = prefix + ".v"
+        self.edge_file = prefix + ".e"
+        self.directed = directed
+        self.num_vertices = count_lines(self.vertex_file)
+        self.num_edges = count_lines(self.edge_file)
+        self.weighted = is_weighted(self.edge_file)
+        self.source_vertex = read_source_vertex(prefix, name, self.edge_file)
+
+    def size(self):
+        return self.num_vertices + self.num_edges
+
+
+def parts(path):
+    """The file itself, or the parts written by multiple ranks of generate."""
+    return [path] if os.path.isfile(path) else sorted(glob.glob(path + ".[0-9]*"))
+
+
+def count_lines(path):
+    count = 0
+
+    for part in parts(path):
+        with open(part, "rb") as f:
+            for block in iter(lambda: f.read(1 << 20), b""):
+                count += block.count(b"\n")
+
+    return count
+
+
+def first_edge(path):
+    for part in parts(path):
+        with open(part) as f:
+            for line in f:
+                if line.strip() and not line.startswith("#"):
+                    return line.split()
+
+    return None
+
+
+def is_weighted(path):
+    edge = first_edge(path)
+    return edge is not None and len(edge) > 2
+
+
+def read_source_vertex(prefix, name, edge_file):
+    """The source vertex from the Graphalytics properties file if there is one,
+    otherwise the source of the first edge (which cannot be isolated)."""
+    properties = prefix + ".properties"
+
+    if os.path.isfile(properties):
+        with open(properties) as f:
+            for line in f:
+                key, _, value = line.partition("=")
+                if key.strip().endswith(".bfs.source-vertex"):
+                    return int(value.strip())
+
+    edge = first_edge(edge_file)
+    return int(edge[0]) if edge is not None else 0
+
+
+def launcher(mpirun, np):
+    """Command prefix to start a binary on np local ranks. Without mpirun, the
+    binary is started directly as a single process."""
+    if not mpirun:
+        if np != 1:
+            raise ValueError("running on %d ranks requires mpirun" % np)
+        return []
+
+    return shlex.split(mpirun) + ["-np", str(np)]
+
+
+def generate_graph(bin_dir, work_dir, name, args, directed, mpirun=None, np=1):
+    """Generates the graph unless it was already generated with the same arguments."""
+    prefix = os.path.join(work_dir, "graphs", name)
+    args = args + ["--directed", "1" if directed else "0"]
+    stamp = prefix + ".args"
+
+    if not os.path.isfile(stamp) or open(stamp).read() != " ".join(args):
+        os.makedirs(os.path.dirname(prefix), exist_ok=True)
+
+        for path in glob.glob(prefix + ".[ve]*"):
+            os.remove(path)
+
+        command = launcher(mpirun, np) + [os.path.join(bin_dir, "generate"), prefix] + args
+        subprocess.run(command, check=True, stdout=subprocess.DEVNULL)
+
+        with open(stamp, "w") as f:
+            f.write(" ".join(args))
+
+    return Graph(name, prefix, directed)
+
+
+def parse_graph(spec):
+    """Parses NAME:PREFIX:DIRECTED, for graphs in the Graphalytics format."""
+    name, prefix, directed = spec.rsplit(":", 2)
+    return Graph(name, prefix, directed in ("1", "true", "directed"))
+
+
+def algorithm_args(graph, algorithm):
+    args = []
+
+    if algorithm in ("bfs", "sssp"):
+        args += ["--source-vertex", str(graph.source_vertex)]
+    if algorithm in ("pr", "cdlp"):
+        args += ["--max-iterations", str(MAX_ITERATIONS)]
+    if algorithm == "pr":
+        args += ["--damping-factor", str(DAMPING_FACTOR)]
+
+    return args
+
+
+class Run:
+    def __init__(self, returncode, makespan, records, log):
+        self.returncode = returncode
+        self.makespan = makespan
+        self.log = log
+        self.phases = {}
+        self.supersteps = []
+
+        for record in records:
+            if record.get("type") == "phase":
+                self.phases[record["name"]] = record
+            elif record.get("type") == "superstep":
+                self.supersteps.append(record)
+
+    def ok(self):
+        return self.returncode == 0 and "run algorithm" in self.phases
+
+    def phase_time(self, name):
+        record = self.phases.get(name)
+        return record["time_sec"] if record is not None else 0.0
+
+    def load_time(self):
+        return self.phase_time("load graph")
+
+    def processing_time(self):
+        return self.phase_time("run algorithm")
+
+
+def run_main(bin_dir, work_dir, graph, algorithm, mpirun=None, np=1, ncpus=None, extra_args=()):
+    """Runs a single job. The makespan is the wall clock time of the whole
+    job, including starting the ranks and writing the output."""
+    output = os.path.join(work_dir, "output", "%s-%s" % (graph.name, algorithm))
+    os.makedirs(os.path.dirname(output), exist_ok=True)
+
+    command = launcher(mpirun, np) + [
+        os.path.join(bin_dir, "main"),
+        graph.vertex_file, graph.edge_file,
+        "1" if graph.directed else "0", algorithm,
+        "--output-file", output,
+        "--num-vertices", str(graph.num_vertices),
+        "--num-edges", str(graph.num_edges),
+    ] + algorithm_args(graph, algorithm) + list(extra_args)
+
+    if ncpus is not None:
+        command += ["--ncpus", str(ncpus)]
+
+    start = time.time()
+    result = subprocess.run(command, stdout=subprocess.DEVNULL, stderr=subprocess.PIPE,
+                            universal_newlines=True)
+    makespan = time.time() - start
+
+    records = []
+
+    for line in result.stderr.splitlines():
+        if line.startswith('{"type":'):
+            try:
+                records.append(json.loads(line))
+            except ValueError:
+                pass
+
+    return Run(result.returncode, makespan, records, result.stderr)
+
+
+def median(values):
+    return statistics.median(values) if values else 0.0
+
+
+def spread(values):
+    """Relative difference between the slowest and fastest repetition."""
+    m = median(values)
+    return (max(values) - min(values)) / m if len(values) > 1 and m > 0 else 0.0
+
+
+def evps(graph, processing_time):
+    """Graphalytics EVPS: edges plus vertices per second of processing time."""
+    return graph.size() / processing_time if processing_time > 0 else 0.0
@@ -0,0 +1,233 @@
+#!/usr/bin/env python3
+#
+# Copyright 2015 Delft University of Technology
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#         http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+#
+
+# Performance regression harness. Runs all algorithms of the main binary on a
+# fixed set of generated graphs and the real graphs of REAL_GRAPHS found in
+# the Graphalytics graph directory on this machine, without the Java driver,
+# and compares the median load time, processing time, makespan and EVPS to a
+# baseline. Exits with status 1 if a
+# job fails or regresses by more than the threshold, which is widened when
+# the repetitions of the baseline or the current run are noisy.
+#
+# usage: regression.py [--baseline FILE] [--update-baseline] [--np N] ...
+
+import argparse
+import json
+import os
+import sys
+
+import harness
+
+# Fixed set of generated graphs: name, arguments of generate, directed
+GENERATED_GRAPHS = [
+    ("rmat", ["--model", "rmat", "--scale", "{scale}", "--edge-factor", "16"], False),
+    ("er", ["--model", "er", "--vertices", "{vertices}", "--edge-factor", "8"], True),
+    ("powerlaw", ["--model", "powerlaw", "--vertices", "{vertices}", "--edge-factor", "8",
+                  "--exponent", "2.3"], False),
+]
+
+# Default real graphs: Graphalytics datasets of size class XS and S, loaded
+# from --graph-dir as NAME.v, NAME.e and NAME.properties. Name, directed
+REAL_GRAPHS = [
+    ("wiki-Talk", True),
+    ("cit-Patents", True),
+    ("datagen-7_5-fb", False),
+    ("dota-league", False),
+]
+
+METRICS = ["load_sec", "processing_sec", "makespan_sec"]
+
+
+def measure(args, graph, algorithm):
+    runs = []
+
+    for _ in range(args.repetitions):
+        run = harness.run_main(args.bin_dir, args.work_dir, graph, algorithm,
+                               mpirun=args.mpirun, np=args.np, ncpus=args.ncpus)
+
+        if not run.ok():
+            sys.stderr.write(run.log)
+            return None
+
+        runs.append(run)
+
+    values = {
+        "load_sec": [r.load_time() for r in runs],
+        "processing_sec": [r.processing_time() for r in runs],
+        "makespan_sec": [r.makespan for r in runs],
+    }
+
+    result = {
+        "vertices": graph.num_vertices,
+        "edges": graph.num_edges,
+        "noise": {},
+    }
+
+    for metric in METRICS:
+        result[metric] = harness.median(values[metric])
+        result["noise"][metric] = harness.spread(values[metric])
+
+    result["evps"] = harness.evps(graph, result["processing_sec"])
+    return result
+
+
+def tolerance(args, current, baseline, metric):
+    noise = max(current["noise"][metric], baseline.get("noise", {}).get(metric, 0.0))
+    return max(args.threshold, args.noise_factor * noise)
+
+
+def compare(args, key, current, baseline):
+    """Returns the regressed metrics. Load and processing times below the
+    minimum time are ignored, as they mostly measure startup noise."""
+    regressions = []
+
+    for metric in METRICS:
+        base = baseline.get(metric, 0.0)
+
+        if base < args.min_time and current[metric] < args.min_time:
+            continue
+
+        if current[metric] > base * (1.0 + tolerance(args, current, baseline, metric)):
+            regressions.append("%s %.3f -> %.3f sec" % (metric, base, current[metric]))
+
+    return regressions
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Performance regression harness")
+    parser.add_argument("--bin-dir", default="bin/standard",
+                        help="directory with the main and generate binaries")
+    parser.add_argument("--work-dir", default="regression",
+                        help="directory for the generated graphs and the output")
+    parser.add_argument("--baseline", default="regression-baseline.json",
+                        help="baseline to compare to")
+    parser.add_argument("--update-baseline", action="store_true",
+                        help="store the results as the new baseline instead of comparing")
+    parser.add_argument("--mpirun", default="mpirun",
+                        help="command to start local ranks, empty to run a single process directly")
+    parser.add_argument("--np", type=int, default=1, help="number of local ranks")
+    parser.add_argument("--ncpus", type=int, default=None, help="number of threads per rank")
+    parser.add_argument("--scale", type=int, default=16,
+                        help="the generated graphs have 2^scale vertices")
+    parser.add_argument("--graph-dir", default=os.environ.get("GRAPHALYTICS_GRAPHS", "graphs"),
+                        help="directory with the real graphs (graphs.root-directory of Graphalytics)")
+    parser.add_argument("--real-graphs", default=",".join(name for name, _ in REAL_GRAPHS),
+                        help="comma-separated list of real graphs to run, empty for none")
+    parser.add_argument("--graph", action="append", default=[], metavar="NAME:PREFIX:DIRECTED",
+                        help="additional graph in the Graphalytics format (PREFIX.v and PREFIX.e)")
+    parser.add_argument("--algorithms", default=",".join(harness.ALGORITHMS),
+                        help="comma-separated list of algorithms to run")
+    parser.add_argument("--repetitions", type=int, default=3, help="runs of every job")
+    parser.add_argument("--threshold", type=float, default=0.10,
+                        help="minimum relative slowdown reported as a regression")
+    parser.add_argument("--noise-factor", type=float, default=3.0,
+                        help="the threshold is at least this factor times the relative spread of the repetitions")
+    parser.add_argument("--min-time", type=float, default=0.05,
+                        help="times below this many seconds are not compared")
+    args = parser.parse_args()
+
+    graphs = []
+    substitutions = {"scale": args.scale, "vertices": 1 << args.scale}
+
+    for name, generate_args, directed in GENERATED_GRAPHS:
+        generate_args = [a.format(**substitutions) for a in generate_args] + ["--weighted", "1"]
+        graphs.append(harness.generate_graph(args.bin_dir, args.work_dir, name, generate_args,
+                                             directed, mpirun=args.mpirun, np=args.np))
+
+    directed = dict(REAL_GRAPHS)
+
+    for name in filter(None, args.real_graphs.split(",")):
+        prefix = os.path.join(args.graph_dir, name)
+
+        if name not in directed:
+            print("Unknown real graph %s, pass it with --graph NAME:PREFIX:DIRECTED" % name)
+            return 2
+
+        if not os.path.isfile(prefix + ".v"):
+            print("Warning: real graph %s not found in %s, skipping it" % (name, args.graph_dir))
+            continue
+
+        graphs.append(harness.Graph(name, prefix, directed[name]))
+
+    graphs += [harness.parse_graph(spec) for spec in args.graph]
+
+    config = {"np": args.np, "ncpus": args.ncpus, "scale": args.scale}
+    baseline = None
+
+    if not args.update_baseline:
+        if not os.path.isfile(args.baseline):
+            print("Baseline %s does not exist, create it with --update-baseline" % args.baseline)
+            return 2
+
+        with open(args.baseline) as f:
+            baseline = json.load(f)
+
+        if baseline.get("config") != config:
+            print("Warning: baseline was measured with %s, now using %s" % (baseline.get("config"), config))
+
+    results = {}
+    failures = 0
+    regressions = 0
+
+    print("%-24s %12s %12s %12s %14s  %s" % ("job", "load", "processing", "makespan", "EVPS", "status"))
+
+    for graph in graphs:
+        for algorithm in args.algorithms.split(","):
+            key = "%s/%s" % (graph.name, algorithm)
+
+            if algorithm == "sssp" and not graph.weighted:
+                continue
+
+            result = measure(args, graph, algorithm)
+
+            if result is None:
+                print("%-24s %s" % (key, "FAILED"))
+                failures += 1
+                continue
+
+            results[key] = result
+            status = ""
+
+            if baseline is not None:
+                base = baseline["results"].get(key)
+
+                if base is None:
+                    status = "no baseline"
+                else:
+                    regressed = compare(args, key, result, base)
+                    regressions += 1 if regressed else 0
+
+                    change = result["evps"] / base["evps"] - 1.0 if base.get("evps") else 0.0
+                    status = "EVPS %+.1f%%" % (100.0 * change)
+                    if regressed:
+                        status += ", REGRESSION: " + "; ".join(regressed)
+
+            print("%-24s %12.3f %12.3f %12.3f %14.4g  %s" % (
+                key, result["load_sec"], result["processing_sec"], result["makespan_sec"],
+                result["evps"], status), flush=True)
+
+    if args.update_baseline:
+        with open(args.baseline, "w") as f:
+            json.dump({"config": config, "results": results}, f, indent=2, sort_keys=True)
+        print("Stored baseline in %s" % args.baseline)
+
+    print("%d jobs, %d failed, %d regressed" % (len(results) + failures, failures, regressions))
+    return 1 if failures > 0 or regressions > 0 else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,181 @@
+#!/usr/bin/env python3
+#
+# Copyright 2015 Delft University of Technology
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#         http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+#
+
+# Scaling harness. Runs every algorithm with all combinations of the given
+# numbers of local ranks (mpirun -np) and threads per rank (--ncpus), and
+# prints the time, speedup and parallel efficiency of every phase relative
+# to the smallest configuration.
+#
+# Strong scaling uses the same graph for all configurations. Weak scaling
+# generates an R-MAT graph which doubles in size when the number of workers
+# (ranks times threads) doubles, so ideally the time stays the same.
+#
+# usage: scaling.py [--mode strong|weak|both] [--ranks 1,2,4] [--threads 1,2,4] ...
+
+import argparse
+import json
+import math
+import sys
+
+import harness
+
+PHASES = ["load graph", "initialize engine", "run algorithm", "makespan"]
+
+
+def measure(args, graph, algorithm, ranks, threads):
+    """Median time of every phase over the repetitions, None if a run failed."""
+    times = dict((phase, []) for phase in PHASES)
+
+    for _ in range(args.repetitions):
+        run = harness.run_main(args.bin_dir, args.work_dir, graph, algorithm,
+                               mpirun=args.mpirun, np=ranks, ncpus=threads)
+
+        if not run.ok():
+            sys.stderr.write(run.log)
+            return None
+
+        for phase in PHASES:
+            times[phase].append(run.makespan if phase == "makespan" else run.phase_time(phase))
+
+    return dict((phase, harness.median(values)) for phase, values in times.items())
+
+
+def weak_graph(args, workers):
+    scale = args.scale + int(round(math.log2(workers)))
+    name = "weak-%s-%d" % (args.model, scale)
+    return generate(args, name, scale)
+
+
+def generate(args, name, scale):
+    generate_args = ["--model", args.model, "--edge-factor", str(args.edge_factor), "--weighted", "1"]
+
+    if args.model == "rmat":
+        generate_args += ["--scale", str(scale)]
+    else:
+        generate_args += ["--vertices", str(1 << scale)]
+
+    return harness.generate_graph(args.bin_dir, args.work_dir, name, generate_args,
+                                  args.directed, mpirun=args.mpirun, np=max(args.ranks))
+
+
+def print_table(mode, graph_name, algorithm, rows):
+    """Prints the rows (ranks, threads, times) with the speedup and efficiency
+    of every phase relative to the first row."""
+    base_ranks, base_threads, base = rows[0]
+    base_workers = base_ranks * base_threads
+
+    print()
+    print("%s scaling, %s, %s" % (mode, graph_name, algorithm))
+    print("%5s %7s" % ("ranks", "threads") + "".join(" | %-26s" % phase for phase in PHASES))
+    print("%5s %7s" % ("", "") + " | %9s %8s %7s" % ("sec", "speedup", "eff") * len(PHASES))
+
+    for ranks, threads, times in rows:
+        line = "%5d %7d" % (ranks, threads)
+        factor = float(ranks * threads) / base_workers
+
+        for phase in PHASES:
+            speedup = base[phase] / times[phase] if times[phase] > 0 else 0.0
+
+            # With weak scaling the work grows with the workers, so the
+            # efficiency is the speedup itself and the speedup is scaled.
+            if mode == "weak":
+                efficiency = speedup
+                speedup *= factor
+            else:
+                efficiency = speedup / factor
+
+            line += " | %9.3f %7.2fx %6.0f%%" % (times[phase], speedup, 100.0 * efficiency)
+
+        print(line, flush=True)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Strong and weak scaling harness")
+    parser.add_argument("--bin-dir", default="bin/standard",
+                        help="directory with the main and generate binaries")
+    parser.add_argument("--work-dir", default="scaling",
+                        help="directory for the generated graphs and the output")
+    parser.add_argument("--mode", choices=["strong", "weak", "both"], default="both")
+    parser.add_argument("--mpirun", default="mpirun --bind-to none",
+                        help="command to start local ranks, its options (e.g., --bind-to core) are used for all runs")
+    parser.add_argument("--ranks", default="1,2,4", help="comma-separated numbers of local ranks")
+    parser.add_argument("--threads", default="1,2,4", help="comma-separated numbers of threads per rank")
+    parser.add_argument("--algorithms", default=",".join(harness.ALGORITHMS),
+                        help="comma-separated list of algorithms to run")
+    parser.add_argument("--model", choices=["rmat", "er", "powerlaw"], default="rmat",
+                        help="model of the generated graphs")
+    parser.add_argument("--scale", type=int, default=16,
+                        help="strong scaling graph, and weak scaling graph for one worker, has 2^scale vertices")
+    parser.add_argument("--edge-factor", type=int, default=16)
+    parser.add_argument("--directed", action="store_true", help="generate directed graphs")
+    parser.add_argument("--graph", default=None, metavar="NAME:PREFIX:DIRECTED",
+                        help="graph in the Graphalytics format to use for strong scaling instead of a generated one")
+    parser.add_argument("--repetitions", type=int, default=3, help="runs of every configuration")
+    parser.add_argument("--output", default=None, help="also write all measurements to this JSON file")
+    args = parser.parse_args()
+
+    args.ranks = [int(r) for r in args.ranks.split(",")]
+    args.threads = [int(t) for t in args.threads.split(",")]
+    configurations = [(r, t) for r in args.ranks for t in args.threads]
+    configurations.sort(key=lambda c: (c[0] * c[1], c[0]))
+
+    modes = ["strong", "weak"] if args.mode == "both" else [args.mode]
+    results = []
+    failures = 0
+
+    for mode in modes:
+        if mode == "strong":
+            if args.graph is not None:
+                strong_graph = harness.parse_graph(args.graph)
+            else:
+                strong_graph = generate(args, "strong-%s-%d" % (args.model, args.scale), args.scale)
+
+        for algorithm in args.algorithms.split(","):
+            rows = []
+
+            for ranks, threads in configurations:
+                graph = strong_graph if mode == "strong" else weak_graph(args, ranks * threads)
+
+                if algorithm == "sssp" and not graph.weighted:
+                    continue
+
+                times = measure(args, graph, algorithm, ranks, threads)
+
+                if times is None:
+                    print("%s scaling, %s, %s: failed with %d ranks and %d threads"
+                          % (mode, graph.name, algorithm, ranks, threads))
+                    failures += 1
+                    continue
+
+                rows.append((ranks, threads, times))
+                results.append({"mode": mode, "graph": graph.name, "algorithm": algorithm,
+                                "vertices": graph.num_vertices, "edges": graph.num_edges,
+                                "ranks": ranks, "threads": threads, "times": times})
+
+            if rows:
+                graph_name = strong_graph.name if mode == "strong" else "%s (scaled)" % args.model
+                print_table(mode, graph_name, algorithm, rows)
+
+    if args.output is not None:
+        with open(args.output, "w") as f:
+            json.dump(results, f, indent=2)
+
+    return 1 if failures > 0 else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
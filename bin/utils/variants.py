@@ -0,0 +1,117 @@
+#!/usr/bin/env python3
+#
+# Copyright 2015 Delft University of Technology
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#         http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+#
+
+# Checks that variants of the algorithms which depend on the communication
+# between ranks give the same output as the default. Runs every variant and
+# the default on generated graphs with --np local ranks (at least 2, so that
+# vertices have mirrors) and compares the outputs. Exits with status 1 if an
+# output differs or a job fails.
+#
+# usage: variants.py [--np N] [--bin-dir DIR] [--scale S] ...
+
+import argparse
+import os
+import sys
+
+import harness
+
+# Generated graphs: name, arguments of generate, directed
+GRAPHS = [
+    ("rmat", ["--model", "rmat", "--scale", "{scale}", "--edge-factor", "8"], False),
+    ("rmat-directed", ["--model", "rmat", "--scale", "{scale}", "--edge-factor", "8"], True),
+    ("er", ["--model", "er", "--vertices", "{vertices}", "--edge-factor", "4"], False),
+]
+
+# Algorithm, arguments of the variant. Delta synchronization relies on how
+# PowerGraph assigns the data received by mirrors (see mirror.hpp), so it is
+# only correct if these match.
+VARIANTS = [
+    ("cdlp", ["--delta-sync", "1"]),
+    ("cdlp", ["--delta-sync", "1", "--cdlp-incremental", "1"]),
+]
+
+
+def read_output(path):
+    """Lines of the output, sorted by vertex id since the order depends on the ranks."""
+    lines = []
+
+    for part in harness.parts(path):
+        with open(part) as f:
+            lines += [line.split() for line in f if line.strip()]
+
+    return sorted(lines, key=lambda fields: int(fields[0]))
+
+
+def run(args, graph, algorithm, extra_args, name):
+    run = harness.run_main(args.bin_dir, os.path.join(args.work_dir, name), graph, algorithm,
+                           mpirun=args.mpirun, np=args.np, ncpus=args.ncpus, extra_args=extra_args)
+
+    if not run.ok():
+        sys.stderr.write(run.log)
+        return None
+
+    return read_output(os.path.join(args.work_dir, name, "output", "%s-%s" % (graph.name, algorithm)))
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Compares algorithm variants to the default")
+    parser.add_argument("--bin-dir", default="bin/standard",
+                        help="directory with the main and generate binaries")
+    parser.add_argument("--work-dir", default="variants",
+                        help="directory for the generated graphs and the output")
+    parser.add_argument("--mpirun", default="mpirun",
+                        help="command to start local ranks, empty to run a single process directly")
+    parser.add_argument("--np", type=int, default=2, help="number of local ranks")
+    parser.add_argument("--ncpus", type=int, default=None, help="number of threads per rank")
+    parser.add_argument("--scale", type=int, default=14,
+                        help="the generated graphs have 2^scale vertices")
+    args = parser.parse_args()
+
+    substitutions = {"scale": args.scale, "vertices": 1 << args.scale}
+    failures = 0
+
+    for name, generate_args, directed in GRAPHS:
+        generate_args = [a.format(**substitutions) for a in generate_args]
+        graph = harness.generate_graph(args.bin_dir, args.work_dir, name, generate_args,
+                                       directed, mpirun=args.mpirun, np=args.np)
+        expected = {}
+
+        for algorithm, extra_args in VARIANTS:
+            key = "%s/%s %s" % (graph.name, algorithm, " ".join(extra_args))
+
+            if algorithm not in expected:
+                expected[algorithm] = run(args, graph, algorithm, [], "default")
+
+            output = run(args, graph, algorithm, extra_args, "variant")
+
+            if expected[algorithm] is None or output is None:
+                status = "FAILED"
+            elif output != expected[algorithm]:
+                differing = sum(1 for a, b in zip(output, expected[algorithm]) if a != b)
+                status = "DIFFERS (%d of %d vertices)" % (differing, len(expected[algorithm]))
+            else:
+                status = "OK"
+
+            failures += status != "OK"
+            print("%-48s %s" % (key, status), flush=True)
+
+    print("%d variants differ or failed" % failures)
+    return 1 if failures > 0 else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
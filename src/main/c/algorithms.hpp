@@ -27,6 +27,23 @@ struct context_t {
     graphlab::command_line_options& clopts;
     bool output_enabled;
     std::ostream *output_stream;
+
+    // Size of the graph, 0 if unknown
+    size_t num_vertices;
+    size_t num_edges;
+
+    // Memory budget in MB per rank, 0 if unlimited
+    size_t memory_budget;
+
+    // Checkpoints of iterative algorithms, disabled if the directory is empty
+    std::string checkpoint_dir;
+    size_t checkpoint_interval;
+    bool resume;
+
+    // Output of a previous run and the edges inserted and deleted since,
+    // incremental recomputation is disabled if prior_result is empty
+    std::string prior_result;
+    std::string edge_updates;
 };
 
 namespace graphalytics {
@@ -45,6 +62,7 @@ namespace graphalytics {
                 bool directed,
                 double damping_factor,
                 int max_iter,
+                double tolerance,
                 std::string job_id);
     }
 
@@ -52,6 +70,7 @@ namespace graphalytics {
         void run(
                 context_t &ctx,
                 int max_iter,
+                bool incremental,
                 std::string job_id);
     }
 
@@ -65,6 +84,12 @@ namespace graphalytics {
         void run(
                 context_t &ctx,
                 bool directed,
+                bool forward,
+                size_t hub_threshold,
+                size_t memory_budget,
+                size_t rounds,
+                bool compress,
+                size_t sample_size,
                 std::string job_id);
     }
 
@@ -75,6 +100,20 @@ namespace graphalytics {
                 graphlab::vertex_id_type source,
                 std::string job_id);
     }
+
+    // Runs the algorithm on a graph in shared memory instead of the engine,
+    // returns false if the graph cannot be loaded
+    namespace shm {
+        bool run(
+                context_t &ctx,
+                const std::string &algorithm,
+                bool directed,
+                graphlab::vertex_id_type source,
+                double damping_factor,
+                int max_iter,
+                size_t grain,
+                std::string job_id);
+    }
 }
 
 #endif
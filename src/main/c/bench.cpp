@@ -0,0 +1,493 @@
+/*
+ * Copyright 2015 Delft University of Technology
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <graphlab.hpp>
+#include <stdlib.h>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <random>
+#include <sstream>
+
+#include "algorithms.hpp"
+
+// Microbenchmarks of the kernels used by the algorithms, on synthetic inputs.
+// The algorithm sources are included for the same reason as in main.cpp. No
+// distributed_control is created, so the benchmarks run as a single process
+// without MPI. Results are written to stdout as one JSON record per kernel.
+#include "cdlp.cpp"
+#include "lcc.cpp"
+#include "sssp.cpp"
+
+
+using namespace std;
+using namespace graphalytics;
+
+// Every allocation made through operator new is counted, including those
+// made by the containers in the kernels.
+static std::atomic<size_t> global_allocations;
+static std::atomic<size_t> global_allocated_bytes;
+
+void* operator new(size_t size) {
+    global_allocations.fetch_add(1, std::memory_order_relaxed);
+    global_allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+
+    void *p = malloc(size == 0 ? 1 : size);
+    if (p == NULL) throw std::bad_alloc();
+
+    return p;
+}
+
+// Not inlined, so the compiler pairs every new expression with this operator
+// delete, rather than with the free it calls
+__attribute__((noinline)) void operator delete(void *p) noexcept {
+    free(p);
+}
+
+// Keeps the compiler from removing the work done by the kernels
+static volatile size_t global_sink;
+
+// Draws numbers in [0, n) where number i has a probability proportional to
+// 1 / (i + 1)^skew. A skew of 0 gives a uniform distribution.
+class zipf_generator {
+    vector<double> cdf;
+    std::uniform_real_distribution<double> uniform;
+
+    public:
+        zipf_generator(size_t n, double skew) : cdf(max(n, size_t(1))) {
+            double sum = 0.0;
+
+            for (size_t i = 0; i < cdf.size(); i++) {
+                sum += 1.0 / pow(double(i + 1), skew);
+                cdf[i] = sum;
+            }
+
+            for (size_t i = 0; i < cdf.size(); i++) {
+                cdf[i] /= sum;
+            }
+        }
+
+        size_t operator()(std::mt19937_64 &rng) {
+            vector<double>::const_iterator it = lower_bound(cdf.begin(), cdf.end(), uniform(rng));
+            return min(size_t(it - cdf.begin()), cdf.size() - 1);
+        }
+};
+
+struct bench_config {
+    size_t size;
+    double skew;
+    double min_time;
+    uint64_t seed;
+    bool directed;
+    size_t stream_size;
+};
+
+// Work done by a single pass over the input of a kernel
+struct pass_result {
+    size_t ops;
+    size_t bytes;
+
+    pass_result(size_t o=0, size_t b=0) : ops(o), bytes(b) {
+        //
+    }
+};
+
+// Runs passes until min_time has passed, after one pass to warm up, and
+// writes the result as a JSON record.
+template <typename F>
+void measure(const bench_config &config, const string &kernel, F pass) {
+    typedef std::chrono::steady_clock clock;
+
+    pass();
+
+    size_t allocations = global_allocations;
+    size_t allocated_bytes = global_allocated_bytes;
+    size_t ops = 0, bytes = 0, passes = 0;
+    double elapsed = 0.0;
+    clock::time_point start = clock::now();
+
+    do {
+        pass_result r = pass();
+        ops += r.ops;
+        bytes += r.bytes;
+        passes++;
+        elapsed = std::chrono::duration<double>(clock::now() - start).count();
+    } while (elapsed < config.min_time);
+
+    allocations = global_allocations - allocations;
+    allocated_bytes = global_allocated_bytes - allocated_bytes;
+    ops = max(ops, size_t(1));
+
+    cout << "{\"type\":\"bench\",\"kernel\":\"" << kernel << "\""
+         << ",\"size\":" << config.size
+         << ",\"skew\":" << config.skew
+         << ",\"passes\":" << passes
+         << ",\"ops\":" << ops
+         << ",\"time_sec\":" << elapsed
+         << ",\"ns_per_op\":" << elapsed * 1e9 / ops
+         << ",\"ops_per_sec\":" << ops / elapsed;
+
+    if (bytes > 0) {
+        cout << ",\"bytes_per_sec\":" << bytes / elapsed;
+    }
+
+    cout << ",\"allocs_per_op\":" << double(allocations) / ops
+         << ",\"alloc_bytes_per_op\":" << double(allocated_bytes) / ops
+         << "}" << endl;
+}
+
+// Stands in for the graph when parsing edges
+template <typename E>
+struct edge_sink {
+    typedef E edge_data_type;
+
+    size_t checksum;
+
+    edge_sink() : checksum(0) {
+        //
+    }
+
+    void add_edge(size_t source, size_t target, const E &data) {
+        checksum += source ^ target;
+    }
+};
+
+// Lines of an edge file with the endpoints drawn from a skewed distribution
+static vector<string> edge_lines(const bench_config &config, bool weighted) {
+    std::mt19937_64 rng(config.seed);
+    zipf_generator vertex(config.size, config.skew);
+    std::uniform_real_distribution<double> weight(0.0, 100.0);
+    vector<string> lines;
+
+    for (size_t i = 0; i < config.size; i++) {
+        ostringstream line;
+        line << vertex(rng) << " " << vertex(rng);
+        if (weighted) line << " " << weight(rng);
+        lines.push_back(line.str());
+    }
+
+    return lines;
+}
+
+template <typename E, typename F>
+static void bench_parse_edge_line(const bench_config &config, const string &kernel,
+                                  bool weighted, const F &parser) {
+    vector<string> lines = edge_lines(config, weighted);
+
+    measure(config, kernel, [&]() {
+        edge_sink<E> graph;
+        size_t bytes = 0;
+
+        for (size_t i = 0; i < lines.size(); i++) {
+            parse_edge_line(graph, "", lines[i], parser);
+            bytes += lines[i].size() + 1;
+        }
+
+        global_sink = graph.checksum;
+        return pass_result(lines.size(), bytes);
+    });
+}
+
+// Labels of the neighbors of a vertex, drawn from a skewed distribution
+static vector<cdlp::label_type> neighbor_labels(const bench_config &config) {
+    std::mt19937_64 rng(config.seed);
+    zipf_generator label(config.size, config.skew);
+    vector<cdlp::label_type> labels;
+
+    for (size_t i = 0; i < config.size; i++) {
+        labels.push_back(label(rng));
+    }
+
+    return labels;
+}
+
+static cdlp::gather_type build_histogram(const vector<cdlp::label_type> &labels) {
+    cdlp::gather_type total;
+
+    for (size_t i = 0; i < labels.size(); i++) {
+        total += cdlp::gather_type(labels[i]);
+    }
+
+    return total;
+}
+
+// Gathering a single label per edge, as done by the gather of CDLP
+static void bench_histogram_add(const bench_config &config) {
+    vector<cdlp::label_type> labels = neighbor_labels(config);
+
+    measure(config, "histogram_add", [&]() {
+        cdlp::gather_type total;
+
+        for (size_t i = 0; i < labels.size(); i++) {
+            total += cdlp::gather_type(labels[i]);
+        }
+
+        global_sink = total.data->size();
+        return pass_result(labels.size());
+    });
+}
+
+// Combining two partial histograms, as done for the gathers of mirrors.
+// One operation is one entry of the merged histogram.
+static void bench_histogram_merge(const bench_config &config) {
+    cdlp::gather_type partial = build_histogram(neighbor_labels(config));
+    size_t entries = partial.get().size();
+
+    measure(config, "histogram_merge", [&]() {
+        cdlp::gather_type total(partial);
+        total += partial;
+
+        global_sink = total.first_item;
+        return pass_result(entries);
+    });
+}
+
+// One operation is one call on a histogram of all neighbor labels
+static void bench_most_common(const bench_config &config) {
+    cdlp::gather_type total = build_histogram(neighbor_labels(config));
+
+    measure(config, "most_common", [&]() {
+        global_sink = cdlp::most_common(total);
+        return pass_result(1);
+    });
+}
+
+// Neighbor lists with skewed lengths (list i has about size / (i + 1)^skew
+// neighbors) and neighbors drawn from a skewed distribution, so that lists
+// overlap more as the skew increases. One operation is one intersection.
+static void bench_count_triangles(const bench_config &config) {
+    const size_t NUM_LISTS = 32;
+
+    std::mt19937_64 rng(config.seed);
+    zipf_generator neighbor(4 * config.size, config.skew);
+    vector<lcc::vertex_data_type> lists(NUM_LISTS);
+    vector<lcc::vertex_id_type> ids;
+
+    for (size_t i = 0; i < NUM_LISTS; i++) {
+        size_t degree = max(size_t(1), size_t(config.size / pow(double(i + 1), config.skew)));
+
+        ids.clear();
+
+        for (size_t j = 0; j < degree; j++) {
+            ids.push_back(lcc::vertex_id_type(neighbor(rng)));
+        }
+
+        lists[i].set_neighbors(ids, config.directed, ids.size());
+    }
+
+    string kernel = lcc::global_compress ? "count_triangles_compressed" : "count_triangles";
+
+    measure(config, kernel, [&]() {
+        size_t count = 0;
+
+        for (size_t a = 0; a < NUM_LISTS; a++) {
+            for (size_t b = 0; b < NUM_LISTS; b++) {
+                lcc::vertex_id_type a_id = 4 * config.size + a;
+                lcc::vertex_id_type b_id = 4 * config.size + b;
+                pair<size_t, size_t> c = config.directed
+                        ? lcc::count_triangles<true>(a_id, lists[a], b_id, lists[b])
+                        : lcc::count_triangles<false>(a_id, lists[a], b_id, lists[b]);
+                count += c.first + c.second;
+            }
+        }
+
+        global_sink = count;
+        return pass_result(NUM_LISTS * NUM_LISTS);
+    });
+}
+
+// Combining distances, as done by the gathers of BFS, WCC and SSSP
+static void bench_min_reducer(const bench_config &config) {
+    std::mt19937_64 rng(config.seed);
+    vector<uint64_t> values;
+
+    for (size_t i = 0; i < config.size; i++) {
+        values.push_back(rng());
+    }
+
+    measure(config, "min_reducer", [&]() {
+        min_reducer<uint64_t> total;
+
+        for (size_t i = 0; i < values.size(); i++) {
+            total += min_reducer<uint64_t>(values[i]);
+        }
+
+        global_sink = total.get();
+        return pass_result(values.size());
+    });
+}
+
+// Memory bandwidth of all threads of this process (STREAM triad). The arrays
+// are first touched by the same threads, with the same static schedule, as
+// they are used, so every page is on the NUMA node of the thread using it.
+// Started under mpirun, every rank reports the bandwidth for its placement.
+static void bench_stream_triad(const bench_config &config) {
+    bench_config stream_config = config;
+    size_t n = stream_config.size = config.stream_size;
+
+    unique_ptr<double[]> a(new double[n]);
+    unique_ptr<double[]> b(new double[n]);
+    unique_ptr<double[]> c(new double[n]);
+
+    #pragma omp parallel for schedule(static)
+    for (size_t i = 0; i < n; i++) {
+        a[i] = 0.0;
+        b[i] = 1.0;
+        c[i] = 2.0;
+    }
+
+    measure(stream_config, "stream_triad", [&]() {
+        #pragma omp parallel for schedule(static)
+        for (size_t i = 0; i < n; i++) {
+            a[i] = b[i] + 3.0 * c[i];
+        }
+
+        global_sink = size_t(a[n / 2]);
+        return pass_result(n, 3 * n * sizeof(double));
+    });
+}
+
+// Writing the output file, one line per vertex, as done by all algorithms
+template <typename T>
+static void bench_format_output(const bench_config &config, const string &kernel, const vector<T> &values) {
+    measure(config, kernel, [&]() {
+        ostringstream out;
+
+        for (size_t i = 0; i < values.size(); i++) {
+            out << i << " " << values[i] << endl;
+        }
+
+        global_sink = out.tellp();
+        return pass_result(values.size(), out.tellp());
+    });
+}
+
+static bool selected(const string &kernels, const string &kernel) {
+    if (kernels == "all") {
+        return true;
+    }
+
+    stringstream ss(kernels);
+    string name;
+
+    while (getline(ss, name, ',')) {
+        if (name == kernel) return true;
+    }
+
+    return false;
+}
+
+int main(int argc, char **argv) {
+    graphlab::command_line_options clopts("Microbenchmarks of the algorithm kernels");
+
+    string kernels = "all";
+    clopts.attach_option("kernels", kernels,
+            "Comma-separated list of kernels to run, or all: parse_edge_line, "
+            "parse_edge_line_weighted, histogram_add, histogram_merge, most_common, "
+            "count_triangles, min_reducer, format_output_label, format_output_double, stream_triad");
+
+    bench_config config;
+    config.size = 100000;
+    clopts.attach_option("size", config.size,
+            "Size of the input of every kernel (lines, labels, neighbors or values)");
+
+    config.skew = 1.0;
+    clopts.attach_option("skew", config.skew,
+            "Exponent of the Zipf distribution of vertices and labels, 0 for uniform");
+
+    config.min_time = 1.0;
+    clopts.attach_option("min-time", config.min_time,
+            "Minimum time to run every kernel, in seconds");
+
+    config.seed = 42;
+    clopts.attach_option("seed", config.seed,
+            "Seed of the random inputs");
+
+    config.directed = false;
+    clopts.attach_option("directed", config.directed,
+            "Use directed neighbor lists (count_triangles only)");
+
+    config.stream_size = size_t(1) << 24;
+    clopts.attach_option("stream-size", config.stream_size,
+            "Number of doubles in each of the three arrays (stream_triad only)");
+
+    clopts.attach_option("lcc-compress", lcc::global_compress,
+            "Use compressed neighbor lists (count_triangles only)");
+
+    clopts.attach_option("hub-threshold", lcc::global_hub_threshold,
+            "Minimum degree of hubs (count_triangles only)");
+
+    if (!clopts.parse(argc, argv)) {
+        cerr << "Error parsing command line arguments" << endl;
+        return EXIT_FAILURE;
+    }
+
+    lcc::global_directed = config.directed;
+
+    if (selected(kernels, "parse_edge_line")) {
+        bench_parse_edge_line<graphlab::empty>(config, "parse_edge_line", false,
+                default_parser<graphlab::empty>);
+    }
+
+    if (selected(kernels, "parse_edge_line_weighted")) {
+        bench_parse_edge_line<double>(config, "parse_edge_line_weighted", true,
+                sssp::edge_data_parser);
+    }
+
+    if (selected(kernels, "histogram_add")) {
+        bench_histogram_add(config);
+    }
+
+    if (selected(kernels, "histogram_merge")) {
+        bench_histogram_merge(config);
+    }
+
+    if (selected(kernels, "most_common")) {
+        bench_most_common(config);
+    }
+
+    if (selected(kernels, "count_triangles")) {
+        bench_count_triangles(config);
+    }
+
+    if (selected(kernels, "min_reducer")) {
+        bench_min_reducer(config);
+    }
+
+    if (selected(kernels, "format_output_label")) {
+        bench_format_output(config, "format_output_label", neighbor_labels(config));
+    }
+
+    if (selected(kernels, "format_output_double")) {
+        std::mt19937_64 rng(config.seed);
+        std::uniform_real_distribution<double> value(0.0, 1.0);
+        vector<double> values;
+
+        for (size_t i = 0; i < config.size; i++) {
+            values.push_back(value(rng));
+        }
+
+        bench_format_output(config, "format_output_double", values);
+    }
+
+    if (selected(kernels, "stream_triad")) {
+        bench_stream_triad(config);
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -18,6 +18,8 @@
 
 #include "algorithms.hpp"
 #include "utils.hpp"
+#include "metrics.hpp"
+#include "incremental.hpp"
 
 #ifdef GRANULA
 #include "granula.hpp"
@@ -34,13 +36,15 @@ typedef graphlab::empty gather_type;
 typedef min_reducer<vertex_data_type> msg_type;
 typedef graphlab::distributed_graph<vertex_data_type, edge_data_type> graph_type;
 
+const vertex_data_type UNREACHED = numeric_limits<vertex_data_type>::max();
+
 static void init_vertex(graph_type::vertex_type &vertex) {
-    vertex.data() = numeric_limits<vertex_data_type>::max();
+    vertex.data() = UNREACHED;
 }
 
-static bool global_directed;
-
-
+// Directed graphs are only traversed along out-edges. The vertex program is
+// instantiated for both cases so no edge needs to test the direction.
+template <bool directed>
 class breadth_first_search :
     public graphlab::ivertex_program<graph_type, gather_type, msg_type>,
     public graphlab::IS_POD_TYPE {
@@ -62,20 +66,22 @@ class breadth_first_search :
                 vertex.data() = last_msg.get();
                 changed = true;
             } else {
-                changed = false;
+                // Signaled without a depth by an incremental run, scatter
+                // the current one
+                changed = last_msg.get() == UNREACHED && vertex.data() != UNREACHED;
             }
         }
 
         edge_dir_type scatter_edges(icontext_type& context, const vertex_type& vertex) const {
             return changed
-                    ? (global_directed
+                    ? (directed
                             ? graphlab::OUT_EDGES
                             : graphlab::ALL_EDGES)
                     : graphlab::NO_EDGES;
         }
 
         void scatter(icontext_type& context, const vertex_type& vertex, edge_type& edge) const {
-            const vertex_type& other = edge.target().id() == vertex.id() ? edge.source() : edge.target();
+            const vertex_type& other = directed || edge.source().id() == vertex.id() ? edge.target() : edge.source();
             vertex_data_type new_dist = vertex.data() + 1;
 
             if (other.data() > new_dist) {
@@ -84,9 +90,182 @@ class breadth_first_search :
         }
 };
 
+// Incremental runs start from the depths of the previous run. A deleted edge
+// from a vertex at depth d - 1 to one at depth d may have been on its last
+// shortest path, so invalidate_depths checks whether the vertex still has a
+// neighbor at depth d - 1. If not, its depth is reset and its neighbors at
+// depth d + 1 are checked in the next superstep. repair_depths then gives
+// every reset vertex the depth through its closest remaining neighbor, and
+// the search continues from the vertices whose depth changed and from the
+// sources of inserted edges, which can only decrease depths.
+typedef incremental::prior_result<uint64_t> prior_type;
+
+template <bool directed>
+class invalidate_depths :
+    public graphlab::ivertex_program<graph_type, size_t>,
+    public graphlab::IS_POD_TYPE {
+
+    vertex_data_type old_depth;
+
+    public:
+        edge_dir_type gather_edges(icontext_type& context, const vertex_type& vertex) const {
+            return directed ? graphlab::IN_EDGES : graphlab::ALL_EDGES;
+        }
+
+        // Counts the neighbors one level closer to the source
+        size_t gather(icontext_type& context, const vertex_type& vertex, edge_type& edge) const {
+            const vertex_type& other = directed || edge.target().id() == vertex.id() ? edge.source() : edge.target();
+            return other.data() != UNREACHED && other.data() + 1 == vertex.data();
+        }
+
+        void apply(icontext_type& context, vertex_type& vertex, const size_t &parents) {
+            old_depth = vertex.data();
+
+            if (parents == 0) {
+                vertex.data() = UNREACHED;
+            }
+        }
+
+        edge_dir_type scatter_edges(icontext_type& context, const vertex_type& vertex) const {
+            return old_depth != UNREACHED && vertex.data() == UNREACHED
+                    ? (directed ? graphlab::OUT_EDGES : graphlab::ALL_EDGES)
+                    : graphlab::NO_EDGES;
+        }
+
+        void scatter(icontext_type& context, const vertex_type& vertex, edge_type& edge) const {
+            const vertex_type& other = directed || edge.source().id() == vertex.id() ? edge.target() : edge.source();
+
+            if (other.data() == old_depth + 1) {
+                context.signal(other);
+            }
+        }
+};
+
+template <bool directed>
+class repair_depths :
+    public graphlab::ivertex_program<graph_type, msg_type>,
+    public graphlab::IS_POD_TYPE {
+
+    public:
+        edge_dir_type gather_edges(icontext_type& context, const vertex_type& vertex) const {
+            return directed ? graphlab::IN_EDGES : graphlab::ALL_EDGES;
+        }
+
+        msg_type gather(icontext_type& context, const vertex_type& vertex, edge_type& edge) const {
+            const vertex_type& other = directed || edge.target().id() == vertex.id() ? edge.source() : edge.target();
+            return other.data() != UNREACHED ? msg_type(other.data() + 1) : msg_type();
+        }
+
+        void apply(icontext_type& context, vertex_type& vertex, const msg_type &total) {
+            vertex.data() = total.get();
+        }
+
+        edge_dir_type scatter_edges(icontext_type& context, const vertex_type& vertex) const {
+            return graphlab::NO_EDGES;
+        }
+};
+
+static void init_prior(graph_type::vertex_type &vertex, const prior_type &prior) {
+    uint64_t depth = prior.get(vertex.id(), UNREACHED);
+    vertex.data() = depth < UNREACHED ? depth : UNREACHED;
+}
+
+// Targets of deleted edges which connected consecutive levels
+static boost::unordered_set<graphlab::vertex_id_type> deleted_targets(const prior_type &prior, bool directed) {
+    boost::unordered_set<graphlab::vertex_id_type> targets;
+
+    for (size_t i = 0; i < prior.updates.size(); i++) {
+        const incremental::edge_update &e = prior.updates[i];
+
+        if (!e.inserted) {
+            uint64_t s = prior.get(e.source, UNREACHED), t = prior.get(e.target, UNREACHED);
+
+            if (s < UNREACHED && t == s + 1) targets.insert(e.target);
+            if (!directed && t < UNREACHED && s == t + 1) targets.insert(e.source);
+        }
+    }
+
+    return targets;
+}
+
+static bool in_set(const graph_type::vertex_type &vertex, const boost::unordered_set<graphlab::vertex_id_type> &ids) {
+    return ids.count(vertex.id()) > 0;
+}
+
+static bool invalidated(const graph_type::vertex_type &vertex, const prior_type &prior) {
+    return vertex.data() == UNREACHED && prior.get(vertex.id(), UNREACHED) < UNREACHED;
+}
+
+static bool is_seed(const graph_type::vertex_type &vertex, const prior_type &prior,
+                    const boost::unordered_set<graphlab::vertex_id_type> &sources) {
+
+    return vertex.data() != UNREACHED
+        && (vertex.data() != prior.get(vertex.id(), UNREACHED) || sources.count(vertex.id()) > 0);
+}
+
+// Runs the vertex program from the given vertices until none is active
+template <typename vertex_program_type>
+void run_until_done(context_t &ctx, graph_type &graph, const graphlab::vertex_set &vertices) {
+    graphlab::omni_engine<metrics::instrumented<vertex_program_type> > engine(ctx.dc, graph, "synchronous", ctx.clopts);
+    engine.signal_vset(vertices);
+
+    metrics::begin_run(ctx.dc);
+    engine.start();
+    metrics::end_run(ctx.dc);
+}
+
+// Updates the depths after deleted edges, returns the vertices to continue
+// the search from
+template <bool directed>
+graphlab::vertex_set repair_after_updates(context_t &ctx, graph_type &graph, const prior_type &prior) {
+    boost::unordered_set<graphlab::vertex_id_type> targets = deleted_targets(prior, directed);
+    boost::unordered_set<graphlab::vertex_id_type> sources = prior.inserted_endpoints(directed);
+
+    timer_next("repair depths");
+    run_until_done<invalidate_depths<directed> >(ctx, graph, graph.select(boost::bind(in_set, _1, boost::cref(targets))));
+    run_until_done<repair_depths<directed> >(ctx, graph, graph.select(boost::bind(invalidated, _1, boost::cref(prior))));
+
+    graphlab::vertex_set seeds = graph.select(boost::bind(is_seed, _1, boost::cref(prior), boost::cref(sources)));
+    incremental::report_seeds(graph, seeds);
+    return seeds;
+}
+
+template <typename vertex_program_type>
+void run_engine(context_t &ctx, graph_type &graph, bool is_master, graphlab::vertex_id_type source,
+                const graphlab::vertex_set *seeds) {
+    // start engine
+    timer_next("initialize engine");
+    graphlab::omni_engine<metrics::instrumented<vertex_program_type> > engine(ctx.dc, graph, "synchronous", ctx.clopts);
+
+    if (seeds != NULL) {
+        engine.signal_vset(*seeds);
+    } else {
+        engine.signal(source, msg_type(0));
+    }
+
+#ifdef GRANULA
+    granula::operation processGraph("PowerGraph", "Id.Unique", "ProcessGraph", "Id.Unique");
+    if(is_master) {
+        cout<<processGraph.getOperationInfo("StartTime", processGraph.getEpoch())<<endl;
+    }
+#endif
+
+    // run algorithm
+    timer_next("run algorithm");
+    metrics::begin_run(ctx.dc);
+    engine.start();
+    metrics::end_run(ctx.dc);
+
+#ifdef GRANULA
+    if(is_master) {
+        cout<<processGraph.getOperationInfo("EndTime", processGraph.getEpoch())<<endl;
+    }
+#endif
+}
+
 void run(context_t &ctx, bool directed, graphlab::vertex_id_type source, string job_id) {
     bool is_master = ctx.dc.procid() == 0;
-    timer_start(is_master);
+    timer_start();
 
 
 #ifdef GRANULA
@@ -102,44 +281,53 @@ void run(context_t &ctx, bool directed, graphlab::vertex_id_type source, string
     granula::linkProcess(getpid(), job_id);
 #endif
 
-    // process parameters
-    global_directed = directed;
+    // check memory budget
+    size_t memory_estimate = memory::estimate(ctx,
+            sizeof(vertex_data_type) + sizeof(breadth_first_search<true>) + sizeof(msg_type), sizeof(edge_data_type));
+
+    if (memory::exceeds_budget(ctx, "bfs", memory_estimate)) {
+        memory::abort_over_budget(ctx);
+    }
 
     // load graph
     timer_next("load graph");
     graph_type graph(ctx.dc);
     load_graph(graph, ctx);
     graph.finalize();
-    graph.transform_vertices(init_vertex);
 
-#ifdef GRANULA
-    if(is_master) {
-        cout<<loadGraph.getOperationInfo("EndTime", loadGraph.getEpoch())<<endl;
-    }
-#endif
+    prior_type prior;
+    bool incremental = !ctx.prior_result.empty();
 
-    // start engine
-    timer_next("initialize engine");
-    graphlab::omni_engine<breadth_first_search> engine(ctx.dc, graph, "synchronous", ctx.clopts);
-    engine.signal(source, msg_type(0));
+    if (incremental) {
+        prior.read(ctx, graph, vector<graphlab::vertex_id_type>(1, source));
 
-#ifdef GRANULA
-    granula::operation processGraph("PowerGraph", "Id.Unique", "ProcessGraph", "Id.Unique");
-    if(is_master) {
-        cout<<processGraph.getOperationInfo("StartTime", processGraph.getEpoch())<<endl;
-    }
-#endif
+        if (prior.get(source, UNREACHED) != 0) {
+            incremental::abort(ctx, "Prior result is not from source " + to_string(source));
+        }
 
-    // run algorithm
-    timer_next("run algorithm");
-    engine.start();
+        graph.transform_vertices(boost::bind(init_prior, _1, boost::cref(prior)));
+    } else {
+        graph.transform_vertices(init_vertex);
+    }
 
 #ifdef GRANULA
     if(is_master) {
-        cout<<processGraph.getOperationInfo("EndTime", processGraph.getEpoch())<<endl;
+        cout<<loadGraph.getOperationInfo("EndTime", loadGraph.getEpoch())<<endl;
     }
 #endif
 
+    if (incremental && directed) {
+        graphlab::vertex_set seeds = repair_after_updates<true>(ctx, graph, prior);
+        run_engine<breadth_first_search<true> >(ctx, graph, is_master, source, &seeds);
+    } else if (incremental) {
+        graphlab::vertex_set seeds = repair_after_updates<false>(ctx, graph, prior);
+        run_engine<breadth_first_search<false> >(ctx, graph, is_master, source, &seeds);
+    } else if (directed) {
+        run_engine<breadth_first_search<true> >(ctx, graph, is_master, source, NULL);
+    } else {
+        run_engine<breadth_first_search<false> >(ctx, graph, is_master, source, NULL);
+    }
+
 #ifdef GRANULA
     granula::operation offloadGraph("PowerGraph", "Id.Unique", "OffloadGraph", "Id.Unique");
     if(is_master) {
@@ -161,7 +349,7 @@ void run(context_t &ctx, bool directed, graphlab::vertex_id_type source, string
             // then the vertex is not connected to the source vertex.
             // According to specs, the output should be max value for
             // signed 64 bit integer.
-            if (d == numeric_limits<vertex_data_type>::max()) {
+            if (d == UNREACHED) {
                 d = numeric_limits<int64_t>::max();
             }
 
@@ -169,7 +357,8 @@ void run(context_t &ctx, bool directed, graphlab::vertex_id_type source, string
         }
     }
 
-    timer_end();
+    timer_end(ctx.dc);
+    metrics::report(ctx.dc, "bfs");
 
 #ifdef GRANULA
     if(is_master) {
@@ -18,6 +18,9 @@
 
 #include "algorithms.hpp"
 #include "utils.hpp"
+#include "metrics.hpp"
+#include "checkpoint.hpp"
+#include "mirror.hpp"
 
 #ifdef GRANULA
 #include "granula.hpp"
@@ -30,7 +33,7 @@ namespace cdlp {
 using namespace std;
 
 typedef uint64_t label_type;
-typedef label_type vertex_data_type;
+typedef mirror::synced<label_type> vertex_data_type;
 typedef graphlab::empty edge_data_type;
 typedef histogram<label_type> gather_type;
 typedef graphlab::distributed_graph<vertex_data_type, edge_data_type> graph_type;
@@ -39,14 +42,12 @@ void init_vertex(graph_type::vertex_type &vertex) {
     vertex.data() = vertex.id();
 }
 
-label_type most_common(const gather_type& total) {
-    typedef gather_type::map_type map_type;
-    const map_type m = total.get();
-
+template <typename M>
+label_type most_common(const M& m) {
     label_type best_label = 0;
     size_t best_freq = 0;
 
-    for (map_type::const_iterator it = m.begin(); it != m.end(); it++) {
+    for (typename M::const_iterator it = m.begin(); it != m.end(); it++) {
         label_type label = it->first;
         size_t freq = it->second;
 
@@ -59,6 +60,10 @@ label_type most_common(const gather_type& total) {
     return best_label;
 }
 
+label_type most_common(const gather_type& total) {
+    return most_common(total.get());
+}
+
 class label_propagation :
     public graphlab::ivertex_program<graph_type, gather_type>,
     public graphlab::IS_POD_TYPE {
@@ -76,31 +81,208 @@ class label_propagation :
         }
 
         void apply(icontext_type& context, vertex_type& vertex, const gather_type &total) {
-            vertex_data_type new_label = most_common(total);
+            changed = vertex.data().update(most_common(total));
+        }
+
+        edge_dir_type scatter_edges(icontext_type& context, const vertex_type& vertex) const {
+            return changed ? graphlab::ALL_EDGES : graphlab::NO_EDGES;
+        }
+
+        void scatter(icontext_type& context, const vertex_type& vertex, edge_type& edge) const {
+            const vertex_type& other = edge.source().id() == vertex.id() ? edge.target() : edge.source();
+            context.signal(other);
+        }
+};
+
+// Message used by the incremental variant: the net change in the label
+// histogram of the receiving vertex caused by neighbors updating their label.
+class label_delta {
+    public:
+        typedef boost::unordered_map<label_type, int64_t> map_type;
+        typedef map_type::const_iterator map_iterator_type;
+
+        map_type deltas;
+
+        label_delta() {
+            //
+        }
+
+        label_delta(label_type old_label, label_type new_label) {
+            deltas[old_label] = -1;
+            deltas[new_label] = 1;
+        }
+
+        label_delta& operator +=(const label_delta& other) {
+            for (map_iterator_type it = other.deltas.begin(); it != other.deltas.end(); it++) {
+                deltas[it->first] += it->second;
+            }
+
+            return *this;
+        }
+
+        void save(graphlab::oarchive& oarc) const {
+            if (compression::enabled()) {
+                compression::save_vector(oarc, std::vector<std::pair<label_type, int64_t> >(deltas.begin(), deltas.end()));
+            } else {
+                oarc << deltas;
+            }
+        }
 
-            if (new_label != vertex.data()) {
-                vertex.data() = new_label;
-                changed = true;
+        void load(graphlab::iarchive& iarc) {
+            if (compression::enabled()) {
+                std::vector<std::pair<label_type, int64_t> > items;
+                compression::load_vector(iarc, items);
+                deltas.clear();
+                deltas.insert(items.begin(), items.end());
             } else {
-                changed = false;
+                iarc >> deltas;
+            }
+        }
+};
+
+// Label histogram of a vertex which is kept alive across iterations. It
+// tracks the current most common label such that applying a delta only
+// requires a full scan when the count of the best label decreases.
+class label_counts {
+    public:
+        typedef boost::unordered_map<label_type, size_t> map_type;
+
+        map_type counts;
+        label_type best_label;
+        size_t best_freq;
+
+        label_counts() {
+            best_label = 0;
+            best_freq = 0;
+        }
+
+        void reset(const map_type& m) {
+            counts = m;
+            rescan();
+        }
+
+        void update(const label_delta& delta) {
+            bool invalidated = false;
+
+            for (label_delta::map_iterator_type it = delta.deltas.begin(); it != delta.deltas.end(); it++) {
+                label_type label = it->first;
+                int64_t change = it->second;
+
+                if (change == 0) {
+                    continue;
+                }
+
+                size_t &freq = counts[label];
+                freq += change;
+
+                if (change < 0 && label == best_label) {
+                    invalidated = true;
+                } else if (freq > best_freq || (freq == best_freq && label < best_label)) {
+                    best_label = label;
+                    best_freq = freq;
+                }
+
+                if (freq == 0) {
+                    counts.erase(label);
+                }
+            }
+
+            if (invalidated) {
+                rescan();
+            }
+        }
+
+    private:
+        void rescan() {
+            best_label = most_common(counts);
+            best_freq = counts.empty() ? 0 : counts[best_label];
+        }
+};
+
+// Histograms indexed by local vertex id. Only the entries of master vertices
+// are used since messages are delivered to and applied on the master.
+static vertex_column<label_counts> global_counts;
+
+class incremental_label_propagation :
+    public graphlab::ivertex_program<graph_type, gather_type, label_delta>,
+    public graphlab::IS_POD_TYPE {
+
+    label_type old_label;
+    bool changed;
+
+    public:
+        void init(icontext_type& context, const vertex_type& vertex, const label_delta& msg) {
+            if (context.iteration() > 0) {
+                global_counts[vertex].update(msg);
             }
         }
 
+        edge_dir_type gather_edges(icontext_type& context, const vertex_type& vertex) const {
+            return context.iteration() == 0 ? graphlab::ALL_EDGES : graphlab::NO_EDGES;
+        }
+
+        gather_type gather(icontext_type& context, const vertex_type& vertex, edge_type& edge) const {
+            const vertex_type& other = edge.source().id() == vertex.id() ? edge.target() : edge.source();
+            return gather_type(other.data());
+        }
+
+        void apply(icontext_type& context, vertex_type& vertex, const gather_type &total) {
+            label_counts &counts = global_counts[vertex];
+
+            if (context.iteration() == 0) {
+                counts.reset(total.get());
+            }
+
+            old_label = vertex.data();
+            changed = vertex.data().update(counts.best_label);
+        }
+
         edge_dir_type scatter_edges(icontext_type& context, const vertex_type& vertex) const {
             return changed ? graphlab::ALL_EDGES : graphlab::NO_EDGES;
         }
 
         void scatter(icontext_type& context, const vertex_type& vertex, edge_type& edge) const {
             const vertex_type& other = edge.source().id() == vertex.id() ? edge.target() : edge.source();
-            context.signal(other);
+            context.signal(other, label_delta(old_label, vertex.data()));
         }
 };
 
+template <typename engine_type>
+void prepare_engine(engine_type &engine) {
+    engine.signal_all();
+}
+
+template <typename vertex_program_type>
+void run_engine(context_t &ctx, graph_type &graph, bool is_master, size_t superstep, size_t max_iter) {
+    typedef graphlab::omni_engine<metrics::instrumented<vertex_program_type> > engine_type;
+
+#ifdef GRANULA
+    granula::operation processGraph("PowerGraph", "Id.Unique", "ProcessGraph", "Id.Unique");
+    if(is_master) {
+        cout<<processGraph.getOperationInfo("StartTime", processGraph.getEpoch())<<endl;
+    }
+#endif
+
+    // load engine and run algorithm, in segments if checkpoints are enabled
+    {
+        mirror::scope sync;
+        checkpoint::run<engine_type>(ctx, graph, "cdlp", superstep, max_iter, prepare_engine<engine_type>);
+    }
+
+#ifdef GRANULA
+    if(is_master) {
+        cout<<processGraph.getOperationInfo("EndTime", processGraph.getEpoch())<<endl;
+    }
+#endif
+}
 
 
-void run(context_t &ctx, int max_iter, string job_id) {
+// Approximate size of one entry of a label histogram (a hash map node)
+const size_t HISTOGRAM_ENTRY_BYTES = 32;
+
+void run(context_t &ctx, int max_iter, bool incremental, string job_id) {
     bool is_master = ctx.dc.procid() == 0;
-    timer_start(is_master);
+    timer_start();
 
 #ifdef GRANULA
     granula::startMonitorProcess(getpid());
@@ -115,43 +297,54 @@ void run(context_t &ctx, int max_iter, string job_id) {
     granula::linkProcess(getpid(), job_id);
 #endif
 
-    // process parameters
-    ctx.clopts.engine_args.set_option("max_iterations", max_iter);
+    // check memory budget. The gathered histograms hold an entry for both
+    // endpoints of every edge, the incremental variant keeps them around.
+    size_t vertex_bytes = sizeof(vertex_data_type) + sizeof(incremental_label_propagation) + sizeof(gather_type);
+    size_t histogram_bytes = 2 * HISTOGRAM_ENTRY_BYTES;
+
+    if (incremental && memory::exceeds_budget(ctx, "incremental cdlp",
+                memory::estimate(ctx, vertex_bytes + sizeof(label_counts), 2 * histogram_bytes))) {
+        if (is_master) {
+            cerr << "Falling back to non-incremental label propagation" << endl;
+        }
+
+        incremental = false;
+    }
+
+    if (!incremental && memory::exceeds_budget(ctx, "cdlp",
+                memory::estimate(ctx, vertex_bytes, histogram_bytes))) {
+        memory::abort_over_budget(ctx);
+    }
 
-    // load graph
+    // load graph, or restore it from a checkpoint
     timer_next("load graph");
     graph_type graph(ctx.dc);
-    load_graph(graph, ctx);
-    graph.finalize();
-    graph.transform_vertices(init_vertex);
+    size_t superstep = checkpoint::resume(ctx, graph, "cdlp");
 
-#ifdef GRANULA
-    if(is_master) {
-        cout<<loadGraph.getOperationInfo("EndTime", loadGraph.getEpoch())<<endl;
+    if (superstep == 0) {
+        load_graph(graph, ctx);
+        graph.finalize();
+        checkpoint::save_partition(ctx, graph, "cdlp");
+        graph.transform_vertices(init_vertex);
     }
-#endif
-
-    // run engine
-    timer_next("initialize engine");
-    graphlab::omni_engine<label_propagation> engine(ctx.dc, graph, "synchronous", ctx.clopts);
-    engine.signal_all();
 
 #ifdef GRANULA
-    granula::operation processGraph("PowerGraph", "Id.Unique", "ProcessGraph", "Id.Unique");
     if(is_master) {
-        cout<<processGraph.getOperationInfo("StartTime", processGraph.getEpoch())<<endl;
+        cout<<loadGraph.getOperationInfo("EndTime", loadGraph.getEpoch())<<endl;
     }
 #endif
 
-    // run algorithm
-    timer_next("run algorithm");
-    engine.start();
-
-#ifdef GRANULA
-    if(is_master) {
-        cout<<processGraph.getOperationInfo("EndTime", processGraph.getEpoch())<<endl;
+    // Vertices only signal their neighbors when their label changes, so both
+    // variants stop as soon as an iteration does not change any label. The
+    // incremental variant rebuilds its histograms at the start of every
+    // segment between checkpoints.
+    if (incremental) {
+        global_counts.assign(graph);
+        run_engine<incremental_label_propagation>(ctx, graph, is_master, superstep, max_iter);
+        global_counts.clear();
+    } else {
+        run_engine<label_propagation>(ctx, graph, is_master, superstep, max_iter);
     }
-#endif
 
 #ifdef GRANULA
     granula::operation offloadGraph("PowerGraph", "Id.Unique", "OffloadGraph", "Id.Unique");
@@ -171,7 +364,9 @@ void run(context_t &ctx, int max_iter, string job_id) {
         }
     }
 
-    timer_end();
+    timer_end(ctx.dc);
+    metrics::report(ctx.dc, "cdlp");
+    mirror::report(ctx.dc, "cdlp");
 
 #ifdef GRANULA
     cout<<offloadGraph.getOperationInfo("EndTime", offloadGraph.getEpoch())<<endl;
@@ -0,0 +1,365 @@
+/*
+ * Copyright 2015 Delft University of Technology
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef CHECKPOINT_HPP
+#define CHECKPOINT_HPP
+
+#include <graphlab.hpp>
+#include <glob.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <algorithm>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "algorithms.hpp"
+#include "metrics.hpp"
+#include "utils.hpp"
+
+// Checkpoints of iterative algorithms (PR and CDLP). The engine is run in
+// segments of at most --checkpoint-interval supersteps. After every segment,
+// each rank copies the data of the vertices it owns and writes it to
+// <checkpoint-dir>/<algorithm>-vertices-<superstep>.<rank> in a background
+// thread while the next segment runs. The partitioned graph is saved once
+// after loading, so --resume restores the partition from the same directory,
+// which may be on node-local storage, instead of loading and partitioning
+// the graph again. Vertex data must be a POD type.
+//
+// Every segment starts with all vertices active. This gives the same result
+// as running without segments for algorithms where an inactive vertex would
+// not change its value, such as PR (all vertices are active in every
+// superstep) and CDLP (a vertex is only inactive if no neighbor changed).
+namespace checkpoint {
+
+const uint64_t MAGIC = 0x4b4350477061724cULL;
+
+struct header : public graphlab::IS_POD_TYPE {
+    uint64_t magic;
+    uint64_t superstep;
+    uint64_t num_procs;
+    uint64_t num_vertices;
+};
+
+static bool enabled(const context_t &ctx) {
+    return !ctx.checkpoint_dir.empty() && ctx.checkpoint_interval > 0;
+}
+
+static std::string partition_prefix(const context_t &ctx, const std::string &algorithm) {
+    return ctx.checkpoint_dir + "/" + algorithm + "-partition.";
+}
+
+static std::string vertices_path(const context_t &ctx, const std::string &algorithm, size_t superstep) {
+    return ctx.checkpoint_dir + "/" + algorithm + "-vertices-" + std::to_string(superstep)
+         + "." + std::to_string(ctx.dc.procid());
+}
+
+// Supersteps of the complete vertex checkpoints written by this rank
+static std::vector<size_t> local_supersteps(const context_t &ctx, const std::string &algorithm) {
+    std::string pattern = ctx.checkpoint_dir + "/" + algorithm + "-vertices-*."
+                        + std::to_string(ctx.dc.procid());
+    std::vector<size_t> supersteps;
+    glob_t matches;
+
+    if (glob(pattern.c_str(), 0, NULL, &matches) == 0) {
+        for (size_t i = 0; i < matches.gl_pathc; i++) {
+            std::string name = matches.gl_pathv[i];
+            size_t start = name.rfind("-vertices-") + strlen("-vertices-");
+            supersteps.push_back(strtoull(name.c_str() + start, NULL, 10));
+        }
+    }
+
+    globfree(&matches);
+    return supersteps;
+}
+
+// Copies the data of the owned vertices and writes it in a background thread
+template <typename G>
+class writer {
+    typedef typename G::vertex_data_type vertex_data_type;
+    typedef std::pair<graphlab::vertex_id_type, vertex_data_type> entry_type;
+
+    context_t &ctx;
+    G &graph;
+    std::string algorithm;
+    std::vector<entry_type> buffer;
+    std::thread thread;
+    size_t last_superstep;
+    bool failed;
+
+    public:
+        size_t num_written;
+        double write_sec;
+
+        writer(context_t &ctx, G &graph, const std::string &algorithm) :
+                ctx(ctx), graph(graph), algorithm(algorithm),
+                last_superstep(0), failed(false), num_written(0), write_sec(0.0) {
+            //
+        }
+
+        ~writer() {
+            wait();
+        }
+
+        // Starts writing the checkpoint of the given superstep. The previous
+        // checkpoint is finished on all ranks first, so older checkpoints
+        // can be removed once this one has been written.
+        void write(size_t superstep) {
+            wait();
+            ctx.dc.barrier();
+
+            buffer.clear();
+
+            for (size_t i = 0, n = graph.num_local_vertices(); i < n; i++) {
+                const typename G::local_vertex_type &v = graph.l_vertex(i);
+
+                if (v.owned()) {
+                    buffer.push_back(std::make_pair(v.global_id(), v.data()));
+                }
+            }
+
+            thread = std::thread(&writer::write_file, this, superstep, last_superstep);
+            last_superstep = superstep;
+        }
+
+        void wait() {
+            if (thread.joinable()) {
+                thread.join();
+            }
+        }
+
+    private:
+        void write_file(size_t superstep, size_t previous) {
+            double start = timer();
+            std::string path = vertices_path(ctx, algorithm, superstep);
+            std::string tmp_path = path + ".tmp";
+
+            header h;
+            h.magic = MAGIC;
+            h.superstep = superstep;
+            h.num_procs = ctx.dc.numprocs();
+            h.num_vertices = buffer.size();
+
+            FILE *f = fopen(tmp_path.c_str(), "wb");
+            bool ok = f != NULL
+                   && fwrite(&h, sizeof(h), 1, f) == 1
+                   && fwrite(buffer.data(), sizeof(entry_type), buffer.size(), f) == buffer.size()
+                   && fflush(f) == 0
+                   && fsync(fileno(f)) == 0;
+
+            if (f != NULL) ok = fclose(f) == 0 && ok;
+            ok = ok && rename(tmp_path.c_str(), path.c_str()) == 0;
+
+            if (!ok) {
+                if (!failed) {
+                    std::cerr << "Failed to write checkpoint " << path << std::endl;
+                }
+
+                failed = true;
+                return;
+            }
+
+            // Keep the previous checkpoint, which is complete on all ranks,
+            // until this one is known to be complete on all ranks as well
+            std::vector<size_t> supersteps = local_supersteps(ctx, algorithm);
+
+            for (size_t i = 0; i < supersteps.size(); i++) {
+                if (supersteps[i] < previous) {
+                    remove(vertices_path(ctx, algorithm, supersteps[i]).c_str());
+                }
+            }
+
+            num_written++;
+            write_sec += timer() - start;
+        }
+};
+
+// Saves the partitioned graph, once after loading, if checkpoints are enabled.
+// Checkpoints of earlier runs are removed, since they may belong to a
+// different partition.
+template <typename G>
+void save_partition(context_t &ctx, G &graph, const std::string &algorithm) {
+    if (enabled(ctx)) {
+        scoped_timer save_timer("save partition");
+        std::vector<size_t> supersteps = local_supersteps(ctx, algorithm);
+
+        for (size_t i = 0; i < supersteps.size(); i++) {
+            remove(vertices_path(ctx, algorithm, supersteps[i]).c_str());
+        }
+
+        graph.save_binary(partition_prefix(ctx, algorithm));
+    }
+}
+
+// Restores the partition and the vertex data of the last checkpoint that is
+// complete on all ranks if --resume is given. Returns the superstep to
+// continue from, or 0 if the graph should be loaded from the input files.
+template <typename G>
+size_t resume(context_t &ctx, G &graph, const std::string &algorithm) {
+    typedef std::pair<graphlab::vertex_id_type, typename G::vertex_data_type> entry_type;
+    bool is_master = ctx.dc.procid() == 0;
+
+    if (!ctx.resume) {
+        return 0;
+    }
+
+    if (!enabled(ctx)) {
+        if (is_master) std::cerr << "Cannot resume without a checkpoint directory" << std::endl;
+        return 0;
+    }
+
+    // Find the last checkpoint present on all ranks
+    std::vector<std::vector<size_t> > supersteps(ctx.dc.numprocs());
+    supersteps[ctx.dc.procid()] = local_supersteps(ctx, algorithm);
+    ctx.dc.all_gather(supersteps);
+
+    size_t superstep = 0;
+
+    for (size_t i = 0; i < supersteps[0].size(); i++) {
+        size_t candidate = supersteps[0][i];
+        bool everywhere = true;
+
+        for (size_t p = 1; p < supersteps.size(); p++) {
+            everywhere = everywhere && std::count(supersteps[p].begin(), supersteps[p].end(), candidate) > 0;
+        }
+
+        if (everywhere) {
+            superstep = std::max(superstep, candidate);
+        }
+    }
+
+    if (superstep == 0) {
+        if (is_master) std::cerr << "No checkpoint to resume from, starting from the beginning" << std::endl;
+        return 0;
+    }
+
+    scoped_timer restore_timer("restore checkpoint");
+
+    size_t errors = graph.load_binary(partition_prefix(ctx, algorithm)) ? 0 : 1;
+
+    std::string path = vertices_path(ctx, algorithm, superstep);
+    FILE *f = fopen(path.c_str(), "rb");
+    header h;
+    std::vector<entry_type> buffer;
+
+    if (f != NULL && fread(&h, sizeof(h), 1, f) == 1 && h.magic == MAGIC
+            && h.superstep == superstep && h.num_procs == ctx.dc.numprocs()) {
+        buffer.resize(h.num_vertices);
+        if (fread(buffer.data(), sizeof(entry_type), buffer.size(), f) != buffer.size()) errors++;
+    } else {
+        errors++;
+    }
+
+    if (f != NULL) fclose(f);
+
+    // The partition is the same as when the checkpoint was written, so the
+    // owned vertices appear in the same order
+    size_t next = 0;
+
+    for (size_t i = 0, n = graph.num_local_vertices(); i < n && errors == 0; i++) {
+        typename G::local_vertex_type v = graph.l_vertex(i);
+
+        if (v.owned()) {
+            if (next >= buffer.size() || buffer[next].first != v.global_id()) {
+                errors++;
+            } else {
+                v.data() = buffer[next++].second;
+            }
+        }
+    }
+
+    if (next != buffer.size()) errors++;
+    ctx.dc.all_reduce(errors);
+
+    if (errors > 0) {
+        if (is_master) std::cerr << "Checkpoint at superstep " << superstep << " is corrupt or was "
+                                 << "written with a different number of ranks" << std::endl;
+        graphlab::mpi_tools::finalize();
+        exit(EXIT_FAILURE);
+    }
+
+    graph.synchronize();
+
+    if (is_master) {
+        std::cerr << "Resuming from the checkpoint at superstep " << superstep << std::endl;
+    }
+
+    return superstep;
+}
+
+// Runs the algorithm from the given superstep up to max_supersteps, in
+// segments separated by checkpoints. For every segment, a new engine is
+// created with max_iterations set to the length of the segment, and
+// prepare(engine) is called before it is started. The first engine is created
+// in the "initialize engine" phase. Stops early if a segment ends because no
+// vertex is active anymore.
+template <typename E, typename G, typename F>
+void run(context_t &ctx, G &graph, const std::string &algorithm,
+         size_t superstep, size_t max_supersteps, F prepare) {
+
+    bool is_master = ctx.dc.procid() == 0;
+    size_t interval = enabled(ctx) ? ctx.checkpoint_interval : max_supersteps;
+    size_t length = std::min(interval, max_supersteps - std::min(superstep, max_supersteps));
+
+    timer_next("initialize engine");
+    ctx.clopts.engine_args.set_option("max_iterations", length);
+    std::unique_ptr<E> engine(new E(ctx.dc, graph, "synchronous", ctx.clopts));
+    prepare(*engine);
+
+    timer_next("run algorithm");
+    writer<G> checkpoints(ctx, graph, algorithm);
+    double run_start = timer();
+    double blocking_sec = 0.0;
+
+    while (length > 0) {
+        metrics::begin_run(ctx.dc);
+        engine->start();
+        metrics::end_run(ctx.dc);
+
+        size_t executed = engine->iteration();
+        superstep += executed;
+
+        if (executed < length || superstep >= max_supersteps) {
+            break;
+        }
+
+        double start = timer();
+        checkpoints.write(superstep);
+
+        length = std::min(interval, max_supersteps - superstep);
+        ctx.clopts.engine_args.set_option("max_iterations", length);
+        engine.reset();
+        engine.reset(new E(ctx.dc, graph, "synchronous", ctx.clopts));
+        prepare(*engine);
+        blocking_sec += timer() - start;
+    }
+
+    checkpoints.wait();
+
+    if (is_master && checkpoints.num_written > 0) {
+        double run_sec = timer() - run_start;
+        std::cerr << "Wrote " << checkpoints.num_written << " checkpoints, blocking "
+                  << blocking_sec << " sec (" << 100.0 * blocking_sec / run_sec << "% of the run), "
+                  << "writing in the background " << checkpoints.write_sec << " sec" << std::endl;
+    }
+}
+
+}
+
+#endif
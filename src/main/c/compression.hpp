@@ -0,0 +1,195 @@
+/*
+ * Copyright 2015 Delft University of Technology
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef COMPRESSION_HPP
+#define COMPRESSION_HPP
+
+#include <graphlab.hpp>
+#include <stdint.h>
+#include <zlib.h>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+// Compression of the large values exchanged between ranks in every
+// superstep: the label histograms gathered by CDLP and the neighbor lists of
+// LCC. When enabled with --compress-payloads, a serialized array of at least
+// --compress-threshold bytes is compressed with zlib at its fastest level,
+// and stored uncompressed if that does not make it smaller. Small values,
+// such as the min_reducer messages of BFS, SSSP and WCC, are not compressed
+// since PowerGraph batches them into its own buffers.
+//
+// The bytes before and after compression and the time spent are counted on
+// every rank, and reported per superstep by metrics.hpp.
+namespace compression {
+
+// Encoding of a serialized array
+const uint8_t RAW = 0;
+const uint8_t ZLIB = 1;
+
+// Totals of one rank, also used for the difference between two points in time
+struct totals : public graphlab::IS_POD_TYPE {
+    uint64_t raw_bytes;
+    uint64_t encoded_bytes;
+    uint64_t compressed_arrays;
+    uint64_t compress_ns;
+    uint64_t decompress_ns;
+
+    totals() : raw_bytes(0), encoded_bytes(0), compressed_arrays(0), compress_ns(0), decompress_ns(0) {
+        //
+    }
+
+    totals& operator +=(const totals &other) {
+        raw_bytes += other.raw_bytes;
+        encoded_bytes += other.encoded_bytes;
+        compressed_arrays += other.compressed_arrays;
+        compress_ns += other.compress_ns;
+        decompress_ns += other.decompress_ns;
+        return *this;
+    }
+
+    totals& operator -=(const totals &other) {
+        raw_bytes -= other.raw_bytes;
+        encoded_bytes -= other.encoded_bytes;
+        compressed_arrays -= other.compressed_arrays;
+        compress_ns -= other.compress_ns;
+        decompress_ns -= other.decompress_ns;
+        return *this;
+    }
+};
+
+static bool global_enabled;
+static size_t global_threshold;
+static std::atomic<uint64_t> global_raw_bytes;
+static std::atomic<uint64_t> global_encoded_bytes;
+static std::atomic<uint64_t> global_compressed_arrays;
+static std::atomic<uint64_t> global_compress_ns;
+static std::atomic<uint64_t> global_decompress_ns;
+
+inline void configure(bool enabled, size_t threshold) {
+    global_enabled = enabled;
+    global_threshold = threshold;
+}
+
+static bool enabled() {
+    return global_enabled;
+}
+
+static totals read() {
+    totals t;
+    t.raw_bytes = global_raw_bytes;
+    t.encoded_bytes = global_encoded_bytes;
+    t.compressed_arrays = global_compressed_arrays;
+    t.compress_ns = global_compress_ns;
+    t.decompress_ns = global_decompress_ns;
+    return t;
+}
+
+static uint64_t elapsed_ns(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Writes the items of a POD array, compressed if it is large enough and
+// compression makes it smaller. Returns the number of bytes written.
+template <typename T>
+size_t save_array(graphlab::oarchive &oarc, const T *items, size_t n) {
+    static thread_local std::vector<Bytef> buffer;
+
+    const char *raw = reinterpret_cast<const char*>(items);
+    uLong raw_bytes = n * sizeof(T);
+    uLongf encoded_bytes = 0;
+    uint8_t mode = RAW;
+
+    if (global_enabled && raw_bytes >= global_threshold) {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+        encoded_bytes = compressBound(raw_bytes);
+        buffer.resize(encoded_bytes);
+
+        if (compress2(buffer.data(), &encoded_bytes, reinterpret_cast<const Bytef*>(raw),
+                      raw_bytes, Z_BEST_SPEED) == Z_OK && encoded_bytes < raw_bytes) {
+            mode = ZLIB;
+        }
+
+        global_compress_ns += elapsed_ns(start);
+    }
+
+    uint64_t count = n;
+    oarc << mode << count;
+
+    size_t written = sizeof(mode) + sizeof(count);
+
+    if (mode == ZLIB) {
+        uint64_t size = encoded_bytes;
+        oarc << size;
+        oarc.write(reinterpret_cast<const char*>(buffer.data()), encoded_bytes);
+        written += sizeof(size) + encoded_bytes;
+        global_compressed_arrays++;
+    } else {
+        oarc.write(raw, raw_bytes);
+        written += raw_bytes;
+    }
+
+    global_raw_bytes += raw_bytes;
+    global_encoded_bytes += written - sizeof(mode) - sizeof(count);
+
+    return written;
+}
+
+template <typename T>
+size_t save_vector(graphlab::oarchive &oarc, const std::vector<T> &items) {
+    return save_array(oarc, items.data(), items.size());
+}
+
+template <typename T>
+void load_vector(graphlab::iarchive &iarc, std::vector<T> &items) {
+    static thread_local std::vector<Bytef> buffer;
+
+    uint8_t mode;
+    uint64_t count;
+    iarc >> mode >> count;
+    items.resize(count);
+
+    if (mode == ZLIB) {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+        uint64_t size;
+        iarc >> size;
+        buffer.resize(size);
+        iarc.read(reinterpret_cast<char*>(buffer.data()), size);
+
+        uLongf raw_bytes = count * sizeof(T);
+        int status = uncompress(reinterpret_cast<Bytef*>(items.data()), &raw_bytes, buffer.data(), size);
+
+        // A corrupt payload would otherwise leave part of the vector
+        // uninitialized. It cannot be reported to the other ranks from
+        // inside the engine, so the process is aborted.
+        if (status != Z_OK || raw_bytes != count * sizeof(T)) {
+            std::cerr << "Cannot decompress payload of " << count * sizeof(T) << " bytes (zlib status "
+                      << status << ", " << raw_bytes << " bytes decompressed), aborting" << std::endl;
+            std::abort();
+        }
+
+        global_decompress_ns += elapsed_ns(start);
+    } else {
+        iarc.read(reinterpret_cast<char*>(items.data()), count * sizeof(T));
+    }
+}
+
+}
+
+#endif
@@ -0,0 +1,420 @@
+/*
+ * Copyright 2015 Delft University of Technology
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef CSR_HPP
+#define CSR_HPP
+
+#include <graphlab.hpp>
+#include <glob.h>
+#include <omp.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <parallel/algorithm>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "utils.hpp"
+
+// Graph in compressed sparse row form for the shared-memory backend, loaded
+// from the same files, with the same parsers, as the distributed graph.
+// Vertices are numbered 0..n-1 in the order of their ids. Out-edges are kept
+// in CSR and in-edges in CSC form, every list sorted by neighbor. For
+// undirected graphs, every edge is stored in both directions as out-edges and
+// the in-edges are the same lists. Like in the distributed graph, self-loops
+// are dropped and duplicate edges are kept.
+namespace csr {
+
+typedef graphlab::vertex_id_type vertex_id_type;
+typedef uint32_t vertex_index;
+
+// Lines are parsed in chunks of about this many bytes
+const size_t CHUNK_BYTES = 1 << 22;
+
+// Files loaded by PowerGraph for the given path: all files in the same
+// directory whose name starts with the name of the path.
+static std::vector<std::string> input_files(const std::string &prefix) {
+    std::vector<std::string> files;
+    glob_t matches;
+
+    if (glob((prefix + "*").c_str(), 0, NULL, &matches) == 0) {
+        for (size_t i = 0; i < matches.gl_pathc; i++) {
+            files.push_back(matches.gl_pathv[i]);
+        }
+    }
+
+    globfree(&matches);
+    return files;
+}
+
+static bool read_file(const std::string &path, std::string &buffer) {
+    std::ifstream in(path.c_str(), std::ios::in | std::ios::binary);
+
+    if (!in.good()) {
+        return false;
+    }
+
+    in.seekg(0, std::ios::end);
+    buffer.resize(size_t(in.tellg()));
+    in.seekg(0, std::ios::beg);
+    in.read(&buffer[0], buffer.size());
+
+    return in.good() || buffer.empty();
+}
+
+// Calls parse_line(builders[thread], file, line) for every line of the files
+// matching the prefix, with the chunks of every file divided over the
+// threads. Returns false if a file cannot be read or a line cannot be parsed.
+template <typename B, typename F>
+bool parse_files(const std::string &prefix, std::vector<B> &builders, const F &parse_line) {
+    std::vector<std::string> files = input_files(prefix);
+    std::string buffer;
+    size_t errors = 0;
+
+    if (files.empty()) {
+        std::cerr << "No files found for " << prefix << std::endl;
+        return false;
+    }
+
+    for (size_t f = 0; f < files.size(); f++) {
+        if (!read_file(files[f], buffer)) {
+            std::cerr << "Cannot read " << files[f] << std::endl;
+            return false;
+        }
+
+        // Chunk boundaries, moved forward to the start of a line
+        std::vector<size_t> bounds(1, 0);
+
+        while (bounds.back() < buffer.size()) {
+            size_t end = std::min(bounds.back() + CHUNK_BYTES, buffer.size());
+            while (end < buffer.size() && buffer[end - 1] != '\n') end++;
+            bounds.push_back(end);
+        }
+
+        #pragma omp parallel for schedule(dynamic) reduction(+:errors)
+        for (size_t c = 0; c < bounds.size() - 1; c++) {
+            B &builder = builders[omp_get_thread_num()];
+            size_t start = bounds[c];
+
+            while (start < bounds[c + 1]) {
+                size_t end = buffer.find('\n', start);
+                if (end == std::string::npos || end > bounds[c + 1]) end = bounds[c + 1];
+
+                if (!parse_line(builder, files[f], buffer.substr(start, end - start))) {
+                    errors++;
+                }
+
+                start = end + 1;
+            }
+        }
+
+        if (errors > 0) {
+            std::cerr << "Cannot parse " << errors << " lines of " << files[f] << std::endl;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// Collects the vertices parsed by one thread
+struct vertex_builder {
+    typedef graphlab::empty vertex_data_type;
+
+    std::vector<vertex_id_type> ids;
+
+    void add_vertex(size_t id, const graphlab::empty &data) {
+        ids.push_back(vertex_id_type(id));
+    }
+};
+
+// Collects the edges parsed by one thread. Edge data is only stored if the
+// graph has any.
+template <typename E>
+struct edge_builder {
+    typedef E edge_data_type;
+
+    std::vector<std::pair<vertex_id_type, vertex_id_type> > edges;
+    std::vector<E> data;
+
+    void add_edge(size_t source, size_t target, const E &d) {
+        edges.push_back(std::make_pair(vertex_id_type(source), vertex_id_type(target)));
+        if (!std::is_same<E, graphlab::empty>::value) data.push_back(d);
+    }
+};
+
+template <typename E>
+class graph {
+    public:
+        typedef E edge_data_type;
+
+        bool directed;
+
+        // Input edges, without self-loops
+        size_t num_edges;
+
+        // Id of every vertex, sorted
+        std::vector<vertex_id_type> ids;
+
+        std::vector<size_t> out_offsets;
+        std::vector<vertex_index> out_targets;
+        std::vector<E> out_data;
+
+        // Only used for directed graphs
+        std::vector<size_t> in_offsets;
+        std::vector<vertex_index> in_sources;
+        std::vector<E> in_data;
+
+        graph() : directed(false), num_edges(0), dense(false) {
+            //
+        }
+
+        size_t num_vertices() const {
+            return ids.size();
+        }
+
+        size_t out_degree(vertex_index v) const {
+            return out_offsets[v + 1] - out_offsets[v];
+        }
+
+        const vertex_index* out_begin(vertex_index v) const {
+            return out_targets.data() + out_offsets[v];
+        }
+
+        const vertex_index* out_end(vertex_index v) const {
+            return out_targets.data() + out_offsets[v + 1];
+        }
+
+        const E* out_edge_data(vertex_index v) const {
+            return out_data.data() + out_offsets[v];
+        }
+
+        size_t in_degree(vertex_index v) const {
+            return directed ? in_offsets[v + 1] - in_offsets[v] : out_degree(v);
+        }
+
+        const vertex_index* in_begin(vertex_index v) const {
+            return directed ? in_sources.data() + in_offsets[v] : out_begin(v);
+        }
+
+        const vertex_index* in_end(vertex_index v) const {
+            return directed ? in_sources.data() + in_offsets[v + 1] : out_end(v);
+        }
+
+        // Offsets and sources of all in-edges, the out-edges for undirected graphs
+        const std::vector<size_t>& in_edge_offsets() const {
+            return directed ? in_offsets : out_offsets;
+        }
+
+        const vertex_index* in_edge_sources() const {
+            return directed ? in_sources.data() : out_targets.data();
+        }
+
+        // Index of the vertex with the given id, or num_vertices() if there is none
+        size_t index_of(vertex_id_type id) const {
+            if (dense) {
+                return id >= ids.front() && id - ids.front() < ids.size() ? size_t(id - ids.front()) : ids.size();
+            }
+
+            std::vector<vertex_id_type>::const_iterator it = std::lower_bound(ids.begin(), ids.end(), id);
+            return it != ids.end() && *it == id ? size_t(it - ids.begin()) : ids.size();
+        }
+
+        // Loads the graph from the vertex and edge files, parsing edge data
+        // with edge_parser. Returns false if the files cannot be parsed.
+        template <typename F>
+        bool load(const std::string &vertex_file, const std::string &edge_file,
+                  bool is_directed, const F &edge_parser) {
+
+            directed = is_directed;
+
+            std::vector<vertex_builder> vertices(omp_get_max_threads());
+            std::vector<edge_builder<E> > edges(omp_get_max_threads());
+
+            bool (*vertex_parser)(const std::string&, graphlab::empty&) = default_parser<graphlab::empty>;
+
+            bool ok = parse_files(vertex_file, vertices,
+                    boost::bind(parse_vertex_line<vertex_builder, bool (*)(const std::string&, graphlab::empty&)>,
+                                _1, _2, _3, boost::ref(vertex_parser)));
+            ok = ok && parse_files(edge_file, edges,
+                    boost::bind(parse_edge_line<edge_builder<E>, F>, _1, _2, _3, boost::ref(edge_parser)));
+
+            if (!ok) {
+                return false;
+            }
+
+            // Vertex ids from the vertex files
+            for (size_t t = 0; t < vertices.size(); t++) {
+                ids.insert(ids.end(), vertices[t].ids.begin(), vertices[t].ids.end());
+                std::vector<vertex_id_type>().swap(vertices[t].ids);
+            }
+
+            // Edges as pairs of indices, in the order of the builders. Ids
+            // which only appear in edges are added and the edges mapped again.
+            std::vector<std::pair<vertex_index, vertex_index> > pairs;
+            size_t num_missing = 1;
+
+            while (num_missing > 0) {
+                sort_ids();
+
+                if (ids.size() >= size_t(std::numeric_limits<vertex_index>::max())) {
+                    std::cerr << "Too many vertices for the shared-memory backend" << std::endl;
+                    return false;
+                }
+
+                pairs.clear();
+                num_missing = 0;
+
+                for (size_t t = 0; t < edges.size(); t++) {
+                    size_t base = pairs.size();
+                    pairs.resize(base + edges[t].edges.size());
+
+                    #pragma omp parallel for reduction(+:num_missing)
+                    for (size_t i = 0; i < edges[t].edges.size(); i++) {
+                        const std::pair<vertex_id_type, vertex_id_type> &e = edges[t].edges[i];
+                        size_t source = index_of(e.first), target = index_of(e.second);
+
+                        num_missing += (source == ids.size()) + (target == ids.size());
+                        pairs[base + i] = std::make_pair(vertex_index(source), vertex_index(target));
+                    }
+                }
+
+                for (size_t t = 0; t < edges.size() && num_missing > 0; t++) {
+                    for (size_t i = 0; i < edges[t].edges.size(); i++) {
+                        ids.push_back(edges[t].edges[i].first);
+                        ids.push_back(edges[t].edges[i].second);
+                    }
+                }
+            }
+
+            std::vector<E> data;
+
+            for (size_t t = 0; t < edges.size(); t++) {
+                data.insert(data.end(), edges[t].data.begin(), edges[t].data.end());
+                std::vector<std::pair<vertex_id_type, vertex_id_type> >().swap(edges[t].edges);
+                std::vector<E>().swap(edges[t].data);
+            }
+
+            num_edges = pairs.size();
+
+            if (directed) {
+                build(pairs, data, false, false, out_offsets, out_targets, out_data);
+                build(pairs, data, true, false, in_offsets, in_sources, in_data);
+            } else {
+                build(pairs, data, false, true, out_offsets, out_targets, out_data);
+            }
+
+            return true;
+        }
+
+    private:
+        // Whether the ids are a contiguous range, so indices can be computed
+        // instead of searched
+        bool dense;
+
+        void sort_ids() {
+            __gnu_parallel::sort(ids.begin(), ids.end());
+            ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+            dense = !ids.empty() && ids.back() - ids.front() == ids.size() - 1;
+        }
+
+        static bool by_neighbor(const std::pair<vertex_index, E> &a, const std::pair<vertex_index, E> &b) {
+            return a.first < b.first;
+        }
+
+        // Builds sorted adjacency lists of the sources (or of the targets if
+        // reverse is set) of the edges. If both is set, every edge is added
+        // to the lists of both endpoints.
+        void build(const std::vector<std::pair<vertex_index, vertex_index> > &pairs,
+                   const std::vector<E> &data, bool reverse, bool both,
+                   std::vector<size_t> &offsets, std::vector<vertex_index> &targets,
+                   std::vector<E> &targets_data) {
+
+            size_t n = ids.size();
+            bool has_data = !data.empty();
+            std::vector<size_t> cursor(n + 1, 0);
+
+            #pragma omp parallel for
+            for (size_t i = 0; i < pairs.size(); i++) {
+                __sync_fetch_and_add(&cursor[reverse ? pairs[i].second : pairs[i].first], 1);
+                if (both) __sync_fetch_and_add(&cursor[pairs[i].second], 1);
+            }
+
+            offsets.assign(n + 1, 0);
+
+            for (size_t v = 0; v < n; v++) {
+                offsets[v + 1] = offsets[v] + cursor[v];
+                cursor[v] = offsets[v];
+            }
+
+            targets.resize(offsets[n]);
+            if (has_data) targets_data.resize(offsets[n]);
+
+            #pragma omp parallel for
+            for (size_t i = 0; i < pairs.size(); i++) {
+                vertex_index s = reverse ? pairs[i].second : pairs[i].first;
+                vertex_index t = reverse ? pairs[i].first : pairs[i].second;
+                size_t p = __sync_fetch_and_add(&cursor[s], 1);
+
+                targets[p] = t;
+                if (has_data) targets_data[p] = data[i];
+
+                if (both) {
+                    p = __sync_fetch_and_add(&cursor[t], 1);
+                    targets[p] = s;
+                    if (has_data) targets_data[p] = data[i];
+                }
+            }
+
+            #pragma omp parallel
+            {
+                std::vector<std::pair<vertex_index, E> > list;
+
+                #pragma omp for schedule(dynamic, 1024)
+                for (size_t v = 0; v < n; v++) {
+                    vertex_index *begin = targets.data() + offsets[v];
+                    vertex_index *end = targets.data() + offsets[v + 1];
+
+                    if (!has_data) {
+                        std::sort(begin, end);
+                        continue;
+                    }
+
+                    E *begin_data = targets_data.data() + offsets[v];
+                    list.clear();
+
+                    for (vertex_index *it = begin; it != end; it++) {
+                        list.push_back(std::make_pair(*it, begin_data[it - begin]));
+                    }
+
+                    std::sort(list.begin(), list.end(), by_neighbor);
+
+                    for (size_t i = 0; i < list.size(); i++) {
+                        begin[i] = list[i].first;
+                        begin_data[i] = list[i].second;
+                    }
+                }
+            }
+        }
+};
+
+}
+
+#endif
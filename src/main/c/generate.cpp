@@ -0,0 +1,403 @@
+/*
+ * Copyright 2015 Delft University of Technology
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <graphlab.hpp>
+#include <fcntl.h>
+#include <omp.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+
+
+
+using namespace std;
+
+typedef pair<size_t, size_t> edge_type;
+
+enum model_type {
+    RMAT,
+    ERDOS_RENYI,
+    POWER_LAW
+};
+
+struct generator_config {
+    model_type model;
+    size_t scale;
+    size_t num_vertices;
+    size_t num_edges;
+    double rmat_a, rmat_b, rmat_c;
+    double exponent;
+    bool directed;
+    bool weighted;
+    uint64_t seed;
+};
+
+// Edges are generated in blocks. Every block has its own random generator,
+// seeded from the block index, so the generated graph only depends on the
+// seed and not on the number of ranks or threads.
+const size_t BLOCK_SIZE = 1 << 16;
+
+static uint64_t mix(uint64_t x) {
+    x += 0x9E3779B97F4A7C15ULL;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+    return x ^ (x >> 31);
+}
+
+static size_t gcd(size_t a, size_t b) {
+    return b == 0 ? a : gcd(b, a % b);
+}
+
+// Bijection on [0, n) which spreads the vertices of high degree (which the
+// R-MAT and power-law models put at the lowest ids) over the id range.
+class vertex_permutation {
+    size_t n, multiplier, offset;
+
+    public:
+        vertex_permutation(size_t n, uint64_t seed) : n(n) {
+            multiplier = size_t(n * 0.6180339887) | 1;
+            while (multiplier > 1 && gcd(multiplier, n) != 1) multiplier--;
+            offset = mix(seed) % n;
+        }
+
+        size_t operator()(size_t v) const {
+            return size_t((unsigned __int128) v * multiplier % n + offset) % n;
+        }
+};
+
+class edge_generator {
+    const generator_config &config;
+    vertex_permutation permutation;
+    std::uniform_real_distribution<double> uniform;
+
+    // Power law: vertex i has an expected degree proportional to
+    // (i + 1)^-alpha, sampled by inverting the continuous approximation of
+    // the distribution function.
+    double alpha;
+    double range;
+
+    size_t rmat_vertex(std::mt19937_64 &rng, size_t &target) {
+        size_t source = 0;
+        target = 0;
+
+        for (size_t level = 0; level < config.scale; level++) {
+            double r = uniform(rng);
+            source <<= 1;
+            target <<= 1;
+
+            if (r < config.rmat_a) {
+                //
+            } else if (r < config.rmat_a + config.rmat_b) {
+                target |= 1;
+            } else if (r < config.rmat_a + config.rmat_b + config.rmat_c) {
+                source |= 1;
+            } else {
+                source |= 1;
+                target |= 1;
+            }
+        }
+
+        return source;
+    }
+
+    size_t power_law_vertex(std::mt19937_64 &rng) {
+        double x = pow(1.0 + uniform(rng) * range, 1.0 / (1.0 - alpha));
+        return min(size_t(x) - 1, config.num_vertices - 1);
+    }
+
+    public:
+        edge_generator(const generator_config &config) :
+                config(config), permutation(config.num_vertices, config.seed) {
+
+            alpha = 1.0 / (config.exponent - 1.0);
+            range = pow(double(config.num_vertices + 1), 1.0 - alpha) - 1.0;
+        }
+
+        edge_type next(std::mt19937_64 &rng) {
+            size_t source = 0, target = 0;
+
+            switch (config.model) {
+                case RMAT:
+                    source = rmat_vertex(rng, target);
+                    break;
+                case ERDOS_RENYI:
+                    source = rng() % config.num_vertices;
+                    target = rng() % config.num_vertices;
+                    break;
+                case POWER_LAW:
+                    source = power_law_vertex(rng);
+                    target = power_law_vertex(rng);
+                    break;
+            }
+
+            source = permutation(source);
+            target = permutation(target);
+
+            if (!config.directed && source > target) {
+                swap(source, target);
+            }
+
+            return make_pair(source, target);
+        }
+};
+
+// Every edge is stored by the rank which owns its source vertex, so that
+// duplicate edges end up on the same rank.
+static size_t owner(const edge_type &e, size_t num_procs) {
+    return mix(e.first) % num_procs;
+}
+
+// Generates the blocks assigned to this rank, bucketed by owner
+static void generate_edges(graphlab::distributed_control &dc, const generator_config &config,
+                           vector<vector<edge_type> > &buckets) {
+    size_t num_blocks = (config.num_edges + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    size_t first_block = num_blocks * dc.procid() / dc.numprocs();
+    size_t last_block = num_blocks * (dc.procid() + 1) / dc.numprocs();
+
+    buckets.assign(dc.numprocs(), vector<edge_type>());
+
+    #pragma omp parallel
+    {
+        edge_generator generator(config);
+        vector<vector<edge_type> > local(dc.numprocs());
+
+        #pragma omp for schedule(dynamic)
+        for (size_t block = first_block; block < last_block; block++) {
+            std::seed_seq seq = {config.seed, uint64_t(block)};
+            std::mt19937_64 rng(seq);
+            size_t n = min(BLOCK_SIZE, config.num_edges - block * BLOCK_SIZE);
+
+            for (size_t i = 0; i < n; i++) {
+                edge_type e = generator.next(rng);
+
+                if (e.first != e.second) {
+                    local[owner(e, dc.numprocs())].push_back(e);
+                }
+            }
+        }
+
+        #pragma omp critical
+        for (size_t p = 0; p < local.size(); p++) {
+            buckets[p].insert(buckets[p].end(), local[p].begin(), local[p].end());
+        }
+    }
+}
+
+// Sends every bucket to its owner, returns the edges owned by this rank.
+// In round k, every rank sends to the rank k places after it, so every
+// pair of ranks only exchanges a single message.
+static void exchange_edges(graphlab::distributed_control &dc, vector<vector<edge_type> > &buckets,
+                           vector<edge_type> &edges) {
+    size_t n = dc.numprocs(), pid = dc.procid();
+
+    edges.swap(buckets[pid]);
+
+    for (size_t k = 1; k < n; k++) {
+        vector<edge_type> buffer;
+
+        dc.send_to((pid + k) % n, buckets[(pid + k) % n]);
+        vector<edge_type>().swap(buckets[(pid + k) % n]);
+
+        dc.recv_from((pid + n - k) % n, buffer);
+        edges.insert(edges.end(), buffer.begin(), buffer.end());
+    }
+}
+
+// Name of the part written by a rank. A single rank writes the file itself.
+static string part_name(const string &path, size_t pid, size_t num_procs) {
+    if (num_procs == 1) {
+        return path;
+    }
+
+    char suffix[16];
+    snprintf(suffix, sizeof(suffix), ".%05zu", pid);
+    return path + suffix;
+}
+
+// PowerGraph lists the parts of a file on every rank, and every rank loads
+// the parts whose index modulo the number of ranks equals its id. To allow
+// loading parts from local disks, empty files are created for the parts of
+// other ranks, without overwriting them if they already exist.
+static void create_placeholders(const string &path, size_t pid, size_t num_procs) {
+    for (size_t p = 0; p < num_procs && num_procs > 1; p++) {
+        if (p != pid) {
+            int fd = open(part_name(path, p, num_procs).c_str(), O_WRONLY | O_CREAT | O_EXCL, 0644);
+            if (fd >= 0) close(fd);
+        }
+    }
+}
+
+static double edge_weight(const generator_config &config, const edge_type &e) {
+    return (mix(config.seed ^ mix(e.first) ^ e.second) >> 11) * (1.0 / (1ULL << 53));
+}
+
+static bool write_vertices(graphlab::distributed_control &dc, const generator_config &config,
+                           const string &path) {
+    size_t first = config.num_vertices * dc.procid() / dc.numprocs();
+    size_t last = config.num_vertices * (dc.procid() + 1) / dc.numprocs();
+
+    ofstream out(part_name(path, dc.procid(), dc.numprocs()).c_str());
+
+    for (size_t v = first; v < last; v++) {
+        out << v << '\n';
+    }
+
+    create_placeholders(path, dc.procid(), dc.numprocs());
+    return bool(out);
+}
+
+static bool write_edges(graphlab::distributed_control &dc, const generator_config &config,
+                        const vector<edge_type> &edges, const string &path) {
+
+    ofstream out(part_name(path, dc.procid(), dc.numprocs()).c_str());
+
+    for (size_t i = 0; i < edges.size(); i++) {
+        out << edges[i].first << ' ' << edges[i].second;
+        if (config.weighted) out << ' ' << edge_weight(config, edges[i]);
+        out << '\n';
+    }
+
+    create_placeholders(path, dc.procid(), dc.numprocs());
+    return bool(out);
+}
+
+int main(int argc, char **argv) {
+    graphlab::mpi_tools::init(argc, argv);
+    graphlab::distributed_control dc;
+    global_logger().set_log_level(LOG_INFO);
+
+    graphlab::command_line_options clopts("Synthetic graph generator");
+
+    string output_prefix;
+    clopts.attach_option("output-prefix", output_prefix,
+            "Write the graph to <prefix>.v and <prefix>.e (one part per rank if there are multiple ranks)");
+    clopts.add_positional("output-prefix");
+
+    string model = "rmat";
+    clopts.attach_option("model", model,
+            "Graph model: rmat (Graph500 Kronecker), er (Erdos-Renyi) or powerlaw (Chung-Lu)");
+
+    generator_config config;
+
+    config.scale = 16;
+    clopts.attach_option("scale", config.scale,
+            "Number of vertices as a power of two (rmat only)");
+
+    config.num_vertices = 0;
+    clopts.attach_option("vertices", config.num_vertices,
+            "Number of vertices (er and powerlaw only)");
+
+    double edge_factor = 16.0;
+    clopts.attach_option("edge-factor", edge_factor,
+            "Number of generated edges per vertex, before removing duplicates");
+
+    config.num_edges = 0;
+    clopts.attach_option("edges", config.num_edges,
+            "Number of generated edges, overrides the edge factor");
+
+    config.rmat_a = 0.57;
+    config.rmat_b = 0.19;
+    config.rmat_c = 0.19;
+    clopts.attach_option("rmat-a", config.rmat_a, "R-MAT probability of the top-left quadrant");
+    clopts.attach_option("rmat-b", config.rmat_b, "R-MAT probability of the top-right quadrant");
+    clopts.attach_option("rmat-c", config.rmat_c, "R-MAT probability of the bottom-left quadrant");
+
+    config.exponent = 2.5;
+    clopts.attach_option("exponent", config.exponent,
+            "Exponent of the degree distribution, larger than 2 (powerlaw only)");
+
+    config.directed = false;
+    clopts.attach_option("directed", config.directed,
+            "Generate a directed graph");
+
+    config.weighted = false;
+    clopts.attach_option("weighted", config.weighted,
+            "Add edge weights in [0, 1) for SSSP");
+
+    config.seed = 1;
+    clopts.attach_option("seed", config.seed,
+            "Seed of the generator, the graph does not depend on the number of ranks or threads");
+
+    if (!clopts.parse(argc, argv)) {
+        dc.cerr() << "Error in parsing command line arguments." << endl;
+        return EXIT_FAILURE;
+    }
+
+    if (model == "rmat") {
+        config.model = RMAT;
+        config.num_vertices = size_t(1) << config.scale;
+    } else if (model == "er") {
+        config.model = ERDOS_RENYI;
+    } else if (model == "powerlaw") {
+        config.model = POWER_LAW;
+    } else {
+        dc.cerr() << "Unknown model: " << model << endl;
+        return EXIT_FAILURE;
+    }
+
+    if (output_prefix.empty() || config.num_vertices == 0) {
+        dc.cerr() << "Output prefix or number of vertices not specified. Cannot continue" << endl;
+        return EXIT_FAILURE;
+    }
+
+    if (config.model == POWER_LAW && config.exponent <= 2.0) {
+        dc.cerr() << "The exponent of the degree distribution must be larger than 2" << endl;
+        return EXIT_FAILURE;
+    }
+
+    if (config.num_edges == 0) {
+        config.num_edges = size_t(edge_factor * config.num_vertices);
+    }
+
+    omp_set_num_threads(clopts.get_ncpus());
+
+    vector<vector<edge_type> > buckets;
+    vector<edge_type> edges;
+
+    generate_edges(dc, config, buckets);
+    exchange_edges(dc, buckets, edges);
+
+    size_t generated = edges.size();
+    sort(edges.begin(), edges.end());
+    edges.erase(unique(edges.begin(), edges.end()), edges.end());
+
+    bool ok = write_vertices(dc, config, output_prefix + ".v")
+           && write_edges(dc, config, edges, output_prefix + ".e");
+
+    size_t num_edges = edges.size();
+    size_t duplicates = generated - num_edges;
+    size_t failures = ok ? 0 : 1;
+    dc.all_reduce(num_edges);
+    dc.all_reduce(duplicates);
+    dc.all_reduce(failures);
+
+    if (dc.procid() == 0) {
+        cerr << "Generated " << config.num_vertices << " vertices and " << num_edges << " edges ("
+             << duplicates << " duplicates and "
+             << config.num_edges - num_edges - duplicates << " self-loops removed)" << endl;
+    }
+
+    if (failures > 0) {
+        dc.cerr() << "Failed to write the graph to " << output_prefix << endl;
+    }
+
+    graphlab::mpi_tools::finalize();
+    return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -14,12 +14,16 @@
  * limitations under the License.
  */
 #pragma once
+#include <atomic>
 #include <chrono>
 #include <iostream>
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
 #include <string.h>
+#include <string>
+#include <thread>
+#include <vector>
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
@@ -76,64 +80,190 @@ namespace granula {
         exit(0);
     }
 
+    // Sends messages to the Granula monitor from a background thread, so the
+    // algorithm never waits for the network. Messages are pushed on a lock-free
+    // list, and the thread echoes every message to stdout and sends it over a
+    // connection of its own, as the monitor expects. If the monitor cannot be
+    // reached, messages are appended to the file named by GRANULA_MONITOR_FILE
+    // (default: granula-monitor.log).
+    class emitter {
+        public:
+            static emitter& instance() {
+                static emitter e;
+                return e;
+            }
+
+            void send(const string &message) {
+                chrono::steady_clock::time_point before = chrono::steady_clock::now();
+
+                node *n = new node(message);
+                n->next = head.load(memory_order_relaxed);
+                while (!head.compare_exchange_weak(n->next, n, memory_order_release, memory_order_relaxed));
+                pending++;
+
+                enqueue_nsec += chrono::duration_cast<chrono::nanoseconds>(
+                        chrono::steady_clock::now() - before).count();
+            }
+
+            // Waits until all queued messages have been written, or until the timeout expires.
+            void flush(int timeout_ms = 5000) {
+                for (int i = 0; pending > 0 && i < timeout_ms; i++) {
+                    this_thread::sleep_for(chrono::milliseconds(1));
+                }
+            }
+
+            void printStats() {
+                fprintf(stdout, "Granula emitter: %zu messages (%zu bytes) sent to the monitor, %zu to file, %.3f ms spent queueing.\n",
+                        size_t(messages), size_t(bytes), size_t(file_messages), enqueue_nsec / 1e6);
+            }
+
+            ~emitter() {
+                stopping = true;
+                worker.join();
+
+                if (addresses != NULL) freeaddrinfo(addresses);
+                if (file != NULL) fclose(file);
+            }
+
+        private:
+            static const char *const HOST;
+            static const char *const PORT;
+            static const int POLL_INTERVAL_MS = 5;
+
+            struct node {
+                string message;
+                node *next;
+
+                node(const string &message) : message(message), next(NULL) {
+                    //
+                }
+            };
+
+            atomic<node*> head;
+            atomic<size_t> pending;
+            atomic<bool> stopping;
+            atomic<size_t> enqueue_nsec;
+            atomic<size_t> messages;
+            atomic<size_t> file_messages;
+            atomic<size_t> bytes;
+            struct addrinfo *addresses;
+            FILE *file;
+            bool file_opened;
+            thread worker;
+
+            emitter() : head(NULL), pending(0), stopping(false), enqueue_nsec(0),
+                        messages(0), file_messages(0), bytes(0), addresses(NULL), file(NULL),
+                        file_opened(false) {
+                worker = thread(&emitter::run, this);
+            }
+
+            void run() {
+                struct addrinfo hints;
+                memset(&hints, 0, sizeof(hints));
+                hints.ai_family = AF_UNSPEC;
+                hints.ai_socktype = SOCK_STREAM;
+
+                if (getaddrinfo(HOST, PORT, &hints, &addresses) != 0) {
+                    addresses = NULL;
+                }
+
+                while (true) {
+                    node *list = head.exchange(NULL, memory_order_acquire);
+
+                    if (list == NULL) {
+                        if (stopping) break;
+                        this_thread::sleep_for(chrono::milliseconds(POLL_INTERVAL_MS));
+                        continue;
+                    }
+
+                    // The list is in reverse order of arrival
+                    vector<node*> nodes;
+                    for (node *n = list; n != NULL; n = n->next) {
+                        nodes.push_back(n);
+                    }
+
+                    for (size_t i = nodes.size(); i-- > 0;) {
+                        string line = nodes[i]->message + '\n';
+                        cout.write(line.data(), line.size());
+                        cout.flush();
+
+                        if (writeMessage(nodes[i]->message)) {
+                            messages++;
+                            bytes += nodes[i]->message.size();
+                        } else {
+                            writeFile(line);
+                            file_messages++;
+                        }
+
+                        delete nodes[i];
+                        pending--;
+                    }
+                }
+            }
+
+            // Opens a connection for the message and closes it once the
+            // message is written. Returns false if the monitor is not reachable.
+            bool writeMessage(const string &message) {
+                int sockfd = -1;
+
+                for (struct addrinfo *a = addresses; a != NULL && sockfd < 0; a = a->ai_next) {
+                    sockfd = socket(a->ai_family, a->ai_socktype, a->ai_protocol);
+
+                    if (sockfd >= 0 && connect(sockfd, a->ai_addr, a->ai_addrlen) < 0) {
+                        close(sockfd);
+                        sockfd = -1;
+                    }
+                }
+
+                if (sockfd < 0) {
+                    return false;
+                }
+
+                size_t offset = 0;
+
+                while (offset < message.size()) {
+                    ssize_t n = ::send(sockfd, message.data() + offset, message.size() - offset, MSG_NOSIGNAL);
+
+                    if (n < 0) {
+                        perror("Cannot write to Granula monitor");
+                        break;
+                    }
+
+                    offset += n;
+                }
+
+                close(sockfd);
+                return offset == message.size();
+            }
+
+            void writeFile(const string &line) {
+                if (!file_opened) {
+                    file_opened = true;
+                    const char *path = getenv("GRANULA_MONITOR_FILE");
+                    if (path == NULL) path = "granula-monitor.log";
+
+                    fprintf(stdout, "Granula monitor not reachable, writing messages to %s.\n", path);
+                    file = fopen(path, "a");
+
+                    if (file == NULL) {
+                        perror("Cannot open Granula monitor file");
+                    }
+                }
+
+                if (file == NULL) {
+                    return;
+                }
+
+                fwrite(line.data(), 1, line.size(), file);
+                fflush(file);
+            }
+    };
+
+    const char *const emitter::HOST = "localhost";
+    const char *const emitter::PORT = "2656";
+
     void sendMonitorMessage(std::string message) {
-        fprintf(stdout, "Communicating with Granula monitor.\n");
-        // server: for lookup of server address
-        // serv_addr: serv_addr
-        // portno: port number
-        // buffer: message content
-        // n = message length counter
-        // sockfd: socket tool
-        int sockfd, portno, n;
-        struct sockaddr_in serv_addr;
-        struct hostent *server;
-        char buffer[512];
-
-        portno = 2656;
-
-        // setup socket object
-        sockfd = socket(AF_INET, SOCK_STREAM, 0);
-        if (sockfd < 0) {
-            fprintf(stdout, "Connection Failed: cannot open socket.\n");
-            return;
-        }
-
-        // set up server by hostname
-        server = gethostbyname("localhost");
-        if (server == NULL) {
-            fprintf(stdout, "Connection Failed: no such host.\n");
-            close(sockfd);
-            return;
-        }
-
-        // set up server address using server object
-        bzero((char *) &serv_addr, sizeof(serv_addr));
-        serv_addr.sin_family = AF_INET;
-        bcopy((char *) server->h_addr, (char *) &serv_addr.sin_addr.s_addr, server->h_length);
-
-        serv_addr.sin_port = htons(portno);
-
-        // connect socket to server address
-        if (connect(sockfd, (struct sockaddr *) &serv_addr, sizeof(serv_addr)) < 0) {
-            fprintf(stdout, "Connection Failed: cannot connect to server.\n");
-            close(sockfd);
-            return;
-        }
-
-        // buffer message before send
-        bzero(buffer, 512);
-        message.copy(buffer, message.length());
-        std::cout.write(buffer, message.length());
-        std::cout.put('\n');
-
-        // write to socket
-        n = write(sockfd, buffer, strlen(buffer));
-        if (n < 0) {
-             fprintf(stdout, "Connection Failed: cannot write to socket.\n");
-             close(sockfd);
-        }
-
-        close(sockfd);
+        emitter::instance().send(message);
     }
 
 
@@ -156,6 +286,10 @@ namespace granula {
     void stopMonitorProcess(int processId) {
         std::string message = "{\"type\":\"Monitor\", \"state\":\"StopMonitorProcess\", \"processId\":\""+std::to_string(processId)+"\"}";
         sendMonitorMessage(message);
+
+        // This is the last message of the job, make sure it is delivered
+        emitter::instance().flush();
+        emitter::instance().printStats();
     }
 
 }
@@ -0,0 +1,230 @@
+/*
+ * Copyright 2015 Delft University of Technology
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef INCREMENTAL_HPP
+#define INCREMENTAL_HPP
+
+#include <graphlab.hpp>
+#include <boost/unordered_map.hpp>
+#include <boost/unordered_set.hpp>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "algorithms.hpp"
+
+#ifdef GRANULA
+#include "granula.hpp"
+#endif
+
+// Recomputation of BFS, WCC and PR after a small batch of edge updates. The
+// graph files describe the graph after the updates, --prior-result is the
+// output of a run on the graph before them, and --edge-updates lists the
+// edges inserted ("+ source target") and deleted ("- source target") in
+// between. Every rank reads both files after the graph is finalized, but only
+// keeps the prior values of its own vertices (masters and mirrors) and of the
+// endpoints of the updates, which are exchanged between the ranks. The
+// updates themselves are kept by every rank, so they should be few.
+namespace incremental {
+
+// Stops the job, after printing the message on the master. Must be called
+// by all ranks together.
+static void abort(const context_t &ctx, const std::string &message) {
+    if (ctx.dc.procid() == 0) {
+        std::cerr << message << ", aborting" << std::endl;
+    }
+
+#ifdef GRANULA
+    granula::stopMonitorProcess(getpid());
+#endif
+
+    graphlab::mpi_tools::finalize();
+    exit(EXIT_FAILURE);
+}
+
+struct edge_update {
+    graphlab::vertex_id_type source;
+    graphlab::vertex_id_type target;
+    bool inserted;
+};
+
+template <typename T>
+class prior_result {
+    public:
+        typedef boost::unordered_map<graphlab::vertex_id_type, T> map_type;
+
+        map_type values;
+        std::vector<edge_update> updates;
+
+        // Returns the value of the vertex in the previous run, or missing if
+        // the vertex did not exist yet. Only known for the vertices of this
+        // rank, the endpoints of the updates and the shared ids given to read.
+        T get(graphlab::vertex_id_type id, T missing) const {
+            typename map_type::const_iterator it = values.find(id);
+            return it != values.end() ? it->second : missing;
+        }
+
+        // Vertices with an inserted edge. For directed graphs, only the
+        // sources are included if only_sources is set.
+        boost::unordered_set<graphlab::vertex_id_type> inserted_endpoints(bool only_sources) const {
+            boost::unordered_set<graphlab::vertex_id_type> endpoints;
+
+            for (size_t i = 0; i < updates.size(); i++) {
+                if (updates[i].inserted) {
+                    endpoints.insert(updates[i].source);
+                    if (!only_sources) endpoints.insert(updates[i].target);
+                }
+            }
+
+            return endpoints;
+        }
+
+        // Reads both files, aborts if one of them cannot be read. The prior
+        // values of the endpoints of the updates and of shared_ids are sent
+        // to all ranks.
+        template <typename G>
+        void read(context_t &ctx, G &graph,
+                  const std::vector<graphlab::vertex_id_type> &shared_ids = std::vector<graphlab::vertex_id_type>()) {
+
+            // Every rank reads the files itself, so errors are reported by the
+            // rank that has them, and all ranks stop together
+            size_t errors = 0;
+
+            if (!ctx.edge_updates.empty() && !read_updates(ctx.edge_updates)) {
+                std::cerr << "Rank " << ctx.dc.procid() << ": cannot read edge updates "
+                          << ctx.edge_updates << std::endl;
+                errors++;
+            }
+
+            boost::unordered_set<graphlab::vertex_id_type> shared(shared_ids.begin(), shared_ids.end());
+
+            for (size_t i = 0; i < updates.size(); i++) {
+                shared.insert(updates[i].source);
+                shared.insert(updates[i].target);
+            }
+
+            std::vector<std::vector<std::pair<graphlab::vertex_id_type, T> > > found(ctx.dc.numprocs());
+
+            if (!read_values(ctx.prior_result, graph, shared, found[ctx.dc.procid()])) {
+                std::cerr << "Rank " << ctx.dc.procid() << ": cannot read prior result "
+                          << ctx.prior_result << std::endl;
+                errors++;
+            }
+
+            ctx.dc.all_reduce(errors);
+
+            if (errors > 0) {
+                abort(ctx, "Cannot read the prior result or the edge updates");
+            }
+
+            // Count every vertex on its master only
+            size_t owned = 0;
+
+            for (typename map_type::const_iterator it = values.begin(); it != values.end(); ++it) {
+                owned += graph.l_vertex(graph.local_vid(it->first)).owned();
+            }
+
+            ctx.dc.all_reduce(owned);
+            ctx.dc.all_gather(found);
+
+            for (size_t i = 0; i < found.size(); i++) {
+                values.insert(found[i].begin(), found[i].end());
+            }
+
+            size_t inserted = 0;
+            for (size_t i = 0; i < updates.size(); i++) inserted += updates[i].inserted;
+
+            if (ctx.dc.procid() == 0) {
+                std::cerr << "Incremental run from " << owned << " prior values, "
+                          << inserted << " inserted and " << updates.size() - inserted
+                          << " deleted edges" << std::endl;
+            }
+        }
+
+    private:
+        // Keeps the values of the vertices of this rank, and adds those in
+        // shared to found
+        template <typename G>
+        bool read_values(const std::string &path, G &graph,
+                         const boost::unordered_set<graphlab::vertex_id_type> &shared,
+                         std::vector<std::pair<graphlab::vertex_id_type, T> > &found) {
+            std::ifstream in(path.c_str());
+            std::string line;
+
+            while (std::getline(in, line)) {
+                std::istringstream fields(line);
+                graphlab::vertex_id_type id;
+                T value;
+
+                if (!(fields >> id >> value)) {
+                    return false;
+                }
+
+                if (!graph.contains_vertex(id)) {
+                    continue;
+                }
+
+                values[id] = value;
+
+                if (shared.count(id) > 0) {
+                    found.push_back(std::make_pair(id, value));
+                }
+            }
+
+            return in.eof();
+        }
+
+        bool read_updates(const std::string &path) {
+            std::ifstream in(path.c_str());
+            std::string line;
+
+            while (std::getline(in, line)) {
+                std::istringstream fields(line);
+                std::string op;
+                edge_update update;
+
+                if (line.empty() || line[0] == '#') {
+                    continue;
+                }
+
+                if (!(fields >> op >> update.source >> update.target) || (op != "+" && op != "-")) {
+                    return false;
+                }
+
+                update.inserted = op == "+";
+                updates.push_back(update);
+            }
+
+            return in.eof();
+        }
+};
+
+// Number of vertices in the set, printed as the vertices activated by the
+// updates
+template <typename G>
+void report_seeds(G &graph, const graphlab::vertex_set &seeds) {
+    size_t n = graph.vertex_set_size(seeds);
+
+    if (graph.dc().procid() == 0) {
+        std::cerr << "Reactivated " << n << " of " << graph.num_vertices() << " vertices" << std::endl;
+    }
+}
+
+}
+
+#endif
@@ -0,0 +1,419 @@
+/*
+ * Copyright 2015 Delft University of Technology
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef INTERSECT_HPP
+#define INTERSECT_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+#include <limits>
+#include <vector>
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+// Kernels to intersect two sorted arrays of unique items. Instead of
+// producing the intersection, they call match(i, j) for every pair of
+// positions for which a[i] == b[j], so callers can look up associated
+// data (such as edge multiplicities) stored in parallel arrays.
+namespace intersect {
+
+// If one array is this many times larger than the other, galloping
+// through the larger array is cheaper than a linear merge.
+const size_t GALLOP_RATIO = 32;
+
+template <typename T, typename F>
+void merge_scalar(const T *a, size_t na, size_t i,
+                  const T *b, size_t nb, size_t j, F &match) {
+    while (i < na && j < nb) {
+        if (a[i] < b[j]) {
+            i++;
+        } else if (a[i] > b[j]) {
+            j++;
+        } else {
+            match(i, j);
+            i++;
+            j++;
+        }
+    }
+}
+
+template <typename T, typename F>
+void merge(const T *a, size_t na, const T *b, size_t nb, F &match) {
+    merge_scalar(a, na, 0, b, nb, 0, match);
+}
+
+#ifdef __AVX2__
+// Compares blocks of 4x4 items using all four rotations of the block from b.
+// Falls back to the scalar merge for the remaining tail.
+template <typename F>
+void merge(const uint64_t *a, size_t na, const uint64_t *b, size_t nb, F &match) {
+    size_t i = 0, j = 0;
+
+    while (i + 4 <= na && j + 4 <= nb) {
+        __m256i va = _mm256_loadu_si256((const __m256i *) (a + i));
+        __m256i vb = _mm256_loadu_si256((const __m256i *) (b + j));
+
+        for (int r = 0; r < 4; r++) {
+            int mask = _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpeq_epi64(va, vb)));
+
+            while (mask) {
+                int k = __builtin_ctz(mask);
+                match(i + k, j + ((k + r) & 3));
+                mask &= mask - 1;
+            }
+
+            vb = _mm256_permute4x64_epi64(vb, 0x39);
+        }
+
+        uint64_t a_max = a[i + 3];
+        uint64_t b_max = b[j + 3];
+
+        if (a_max <= b_max) i += 4;
+        if (b_max <= a_max) j += 4;
+    }
+
+    merge_scalar(a, na, i, b, nb, j, match);
+}
+#endif
+
+// For every item of a, exponentially search its position in b starting from
+// the position of the previous item. Requires na to be (much) smaller than nb.
+template <typename T, typename F>
+void gallop(const T *a, size_t na, const T *b, size_t nb, F &match) {
+    size_t j = 0;
+
+    for (size_t i = 0; i < na && j < nb; i++) {
+        const T item = a[i];
+
+        if (b[j] < item) {
+            size_t lo = j;
+            size_t step = 1;
+
+            while (j + step < nb && b[j + step] < item) {
+                lo = j + step;
+                step <<= 1;
+            }
+
+            size_t hi = j + step < nb ? j + step : nb;
+
+            // invariant: b[lo] < item and (hi == nb or b[hi] >= item)
+            while (hi - lo > 1) {
+                size_t mid = lo + (hi - lo) / 2;
+
+                if (b[mid] < item) {
+                    lo = mid;
+                } else {
+                    hi = mid;
+                }
+            }
+
+            j = hi;
+        }
+
+        if (j < nb && b[j] == item) {
+            match(i, j);
+            j++;
+        }
+    }
+}
+
+template <typename F>
+struct swapped_match {
+    F &match;
+
+    swapped_match(F &m) : match(m) {
+        //
+    }
+
+    void operator()(size_t j, size_t i) {
+        match(i, j);
+    }
+};
+
+// Position lookup structure for large sorted arrays. If the items are dense
+// enough, it is a bitmap over the range [base, base + 64 * words.size()) with
+// the number of preceding items stored for every word. Otherwise, it is an
+// open addressing hash table mapping items to their position.
+template <typename T>
+class index {
+    public:
+        // The bitmap is used if it requires at most this many bits per item
+        static const size_t MAX_BITS_PER_ITEM = 32;
+
+        index() {
+            base = 0;
+            mask = 0;
+        }
+
+        void build(const T *items, size_t n) {
+            clear();
+
+            if (n == 0) {
+                return;
+            }
+
+            uint64_t span = uint64_t(items[n - 1] - items[0]) + 1;
+
+            if (span / n <= MAX_BITS_PER_ITEM) {
+                base = items[0];
+                words.resize((span + 63) / 64);
+                ranks.resize(words.size());
+
+                for (size_t i = 0; i < n; i++) {
+                    uint64_t offset = items[i] - base;
+                    words[offset / 64] |= uint64_t(1) << (offset % 64);
+                }
+
+                uint32_t count = 0;
+                for (size_t w = 0; w < words.size(); w++) {
+                    ranks[w] = count;
+                    count += __builtin_popcountll(words[w]);
+                }
+            } else {
+                size_t capacity = 1;
+                while (capacity < 2 * n) capacity <<= 1;
+
+                mask = capacity - 1;
+                keys.assign(capacity, EMPTY);
+                positions.resize(capacity);
+
+                for (size_t i = 0; i < n; i++) {
+                    size_t slot = hash(items[i]);
+
+                    while (keys[slot] != EMPTY) {
+                        slot = (slot + 1) & mask;
+                    }
+
+                    keys[slot] = items[i];
+                    positions[slot] = i;
+                }
+            }
+        }
+
+        void clear() {
+            std::vector<uint64_t>().swap(words);
+            std::vector<uint32_t>().swap(ranks);
+            std::vector<T>().swap(keys);
+            std::vector<uint32_t>().swap(positions);
+            base = 0;
+            mask = 0;
+        }
+
+        bool empty() const {
+            return words.empty() && keys.empty();
+        }
+
+        size_t memory_usage() const {
+            return words.capacity() * sizeof(uint64_t)
+                 + ranks.capacity() * sizeof(uint32_t)
+                 + keys.capacity() * sizeof(T)
+                 + positions.capacity() * sizeof(uint32_t);
+        }
+
+        bool find(T item, size_t &pos) const {
+            if (!words.empty()) {
+                if (item < base) {
+                    return false;
+                }
+
+                uint64_t offset = item - base;
+                uint64_t w = offset / 64;
+
+                if (w >= words.size()) {
+                    return false;
+                }
+
+                uint64_t bit = uint64_t(1) << (offset % 64);
+
+                if (!(words[w] & bit)) {
+                    return false;
+                }
+
+                pos = ranks[w] + __builtin_popcountll(words[w] & (bit - 1));
+                return true;
+            }
+
+            size_t slot = hash(item);
+
+            while (keys[slot] != EMPTY) {
+                if (keys[slot] == item) {
+                    pos = positions[slot];
+                    return true;
+                }
+
+                slot = (slot + 1) & mask;
+            }
+
+            return false;
+        }
+
+    private:
+        static const T EMPTY = std::numeric_limits<T>::max();
+
+        size_t hash(T item) const {
+            return size_t((uint64_t(item) * 0x9E3779B97F4A7C15ULL) >> 17) & mask;
+        }
+
+        T base;
+        size_t mask;
+        std::vector<uint64_t> words;
+        std::vector<uint32_t> ranks;
+        std::vector<T> keys;
+        std::vector<uint32_t> positions;
+};
+
+template <typename T>
+const size_t index<T>::MAX_BITS_PER_ITEM;
+
+template <typename T>
+const T index<T>::EMPTY;
+
+// Looks up every item of a in the index built over array b.
+template <typename T, typename F>
+void probe(const T *a, size_t na, const index<T> &b, F &match) {
+    size_t j;
+
+    for (size_t i = 0; i < na; i++) {
+        if (b.find(a[i], j)) {
+            match(i, j);
+        }
+    }
+}
+
+// Variable-length integer encoding: 7 bits per byte, high bit set if more
+// bytes follow.
+inline void put_varint(std::vector<uint8_t> &out, uint64_t value) {
+    while (value >= 0x80) {
+        out.push_back(uint8_t(value) | 0x80);
+        value >>= 7;
+    }
+
+    out.push_back(uint8_t(value));
+}
+
+inline uint64_t get_varint(const uint8_t *&p) {
+    uint64_t value = 0;
+    int shift = 0;
+
+    while (*p & 0x80) {
+        value |= uint64_t(*p++ & 0x7f) << shift;
+        shift += 7;
+    }
+
+    value |= uint64_t(*p++) << shift;
+    return value;
+}
+
+// Encodes a sorted array of unique items as the number of items followed by
+// the differences between consecutive items. Optionally, a one-bit tag per item
+// (non-zero tags are stored as 1) is stored in the lowest bit of its delta.
+template <typename T>
+void encode_deltas(const T *items, const uint8_t *tags, size_t n, std::vector<uint8_t> &out) {
+    out.clear();
+    put_varint(out, n);
+
+    T prev = 0;
+
+    for (size_t i = 0; i < n; i++) {
+        uint64_t delta = uint64_t(items[i] - prev);
+        prev = items[i];
+
+        if (tags != NULL) {
+            delta = (delta << 1) | (tags[i] > 1 ? 1 : 0);
+        }
+
+        put_varint(out, delta);
+    }
+}
+
+// Decodes the output of encode_deltas one item at a time.
+template <typename T>
+class delta_decoder {
+    public:
+        delta_decoder(const uint8_t *data, bool tagged) : p(data), tagged(tagged) {
+            remaining = get_varint(p);
+            current = 0;
+            current_tag = 0;
+            next();
+        }
+
+        static size_t size(const uint8_t *data) {
+            return get_varint(data);
+        }
+
+        bool valid() const {
+            return remaining != END;
+        }
+
+        T item() const {
+            return current;
+        }
+
+        uint8_t tag() const {
+            return current_tag;
+        }
+
+        void next() {
+            if (remaining == 0) {
+                remaining = END;
+                return;
+            }
+
+            uint64_t delta = get_varint(p);
+
+            if (tagged) {
+                current_tag = uint8_t(delta & 1);
+                delta >>= 1;
+            }
+
+            current += T(delta);
+            remaining--;
+        }
+
+    private:
+        static const size_t END = size_t(-1);
+
+        const uint8_t *p;
+        bool tagged;
+        size_t remaining;
+        T current;
+        uint8_t current_tag;
+};
+
+template <typename T>
+const size_t delta_decoder<T>::END;
+
+// Picks the appropriate kernel based on the relative sizes of the arrays.
+template <typename T, typename F>
+void sorted(const T *a, size_t na, const T *b, size_t nb, F &match) {
+    if (na == 0 || nb == 0) {
+        return;
+    }
+
+    if (na * GALLOP_RATIO < nb) {
+        gallop(a, na, b, nb, match);
+    } else if (nb * GALLOP_RATIO < na) {
+        swapped_match<F> m(match);
+        gallop(b, nb, a, na, m);
+    } else {
+        merge(a, na, b, nb, match);
+    }
+}
+
+}
+
+#endif
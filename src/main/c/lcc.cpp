@@ -14,10 +14,18 @@
  * limitations under the License.
  */
 #include <graphlab.hpp>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
 #include <limits>
+#include <mutex>
+#include <vector>
 
 #include "algorithms.hpp"
+#include "intersect.hpp"
 #include "utils.hpp"
+#include "metrics.hpp"
 
 #ifdef GRANULA
 #include "granula.hpp"
@@ -32,32 +40,820 @@ using namespace std;
 class vertex_data_type;
 
 typedef graphlab::vertex_id_type vertex_id_type;
-typedef histogram<vertex_id_type> gather_type;
-typedef gather_type::map_type neighbors_type;
 typedef size_t msg_type;
 typedef graphlab::distributed_graph<vertex_data_type, graphlab::empty> graph_type;
 
+// Unordered list of neighbor ids. Neighbors connected through multiple edges
+// (i.e., both directions in a directed graph) appear multiple times. The
+// forward variant only stores the higher ranked neighbors in ids and
+// collects the others in backward_ids, which are only needed for the degree.
+// The approximate variant collects the hub neighbors in backward_ids.
+class gather_type {
+    public:
+        vector<vertex_id_type> ids;
+        vector<vertex_id_type> backward_ids;
+
+        gather_type() {
+            //
+        }
+
+        gather_type(vertex_id_type id, bool backward=false) {
+            if (backward) {
+                backward_ids.push_back(id);
+            } else {
+                ids.push_back(id);
+            }
+        }
+
+        gather_type& operator +=(const gather_type& other) {
+            ids.insert(ids.end(), other.ids.begin(), other.ids.end());
+            backward_ids.insert(backward_ids.end(), other.backward_ids.begin(), other.backward_ids.end());
+            return *this;
+        }
+
+        void save(graphlab::oarchive& oarc) const {
+            if (compression::enabled()) {
+                compression::save_vector(oarc, ids);
+                compression::save_vector(oarc, backward_ids);
+            } else {
+                oarc << ids << backward_ids;
+            }
+        }
+
+        void load(graphlab::iarchive& iarc) {
+            if (compression::enabled()) {
+                compression::load_vector(iarc, ids);
+                compression::load_vector(iarc, backward_ids);
+            } else {
+                iarc >> ids >> backward_ids;
+            }
+        }
+};
+
+// The neighbor lists of vertices with at least this many edges get an index
+// for lookups
+static size_t global_hub_threshold = numeric_limits<size_t>::max();
+
+// Whether neighbor lists are stored and sent in compressed form
+static bool global_compress;
+
+// Whether the graph is directed, for the code shared by both instantiations
+// of the vertex programs, like the (de)serialization of neighbor lists.
+static bool global_directed;
+
+// Expected number of neighbors sampled per vertex by the approximate
+// variant, 0 if all coefficients are exact.
+static size_t global_sample_size;
+
+static std::atomic<size_t> global_neighbors_bytes;
+
+// Bytes of neighbor lists serialized by this rank while the engine runs, and
+// the number of bytes the uncompressed representation would have taken.
+// Serializations outside of the engine, like those of the output collection,
+// are not counted.
+static bool global_count_sent;
+static std::atomic<size_t> global_sent_bytes;
+static std::atomic<size_t> global_sent_plain_bytes;
+
 class vertex_data_type {
     public:
-        double clustering_coef;
-        neighbors_type neighbors;
+        // Number of distinct neighbors. Equal to the size of the neighbor list,
+        // except for the forward and memory-bounded variants which only
+        // store part of the neighbors. The approximate variant only counts
+        // the sampled neighbors.
+        size_t degree;
+
+        // Sorted ids of the neighbors. For directed graphs, multiplicity
+        // holds the number of edges connecting to each neighbor (1 or 2). For
+        // undirected graphs, it is left empty since every neighbor is
+        // connected through exactly one edge.
+        vector<vertex_id_type> neighbors;
+        vector<uint8_t> multiplicity;
+
+        // Compressed representation of the same list (see encode_deltas), with
+        // the multiplicity stored in the tag bit. If compression is enabled,
+        // only this representation is kept, except for hubs which also keep
+        // the decoded list locally for lookups through their index.
+        vector<uint8_t> encoded;
+
+        // Lookup structure for the neighbors of high-degree vertices. It is
+        // not serialized, but rebuilt by every replica which receives the list.
+        // The master decides whether the vertex is a hub from its number of
+        // edges, which the replicas do not know, so the decision is sent along.
+        intersect::index<vertex_id_type> hub_index;
+        bool hub;
+
+        // Per neighbor bits of the approximate variant (see SAMPLED_NEIGHBOR)
+        vector<uint8_t> flags;
+
+        vertex_data_type() {
+            degree = 0;
+            hub = false;
+        }
+
+        bool is_decoded() const {
+            return encoded.empty() || !neighbors.empty();
+        }
+
+        size_t size() const {
+            if (is_decoded()) {
+                return neighbors.size();
+            } else {
+                return intersect::delta_decoder<vertex_id_type>::size(encoded.data());
+            }
+        }
+
+        size_t multiplicity_at(size_t i) const {
+            return multiplicity.empty() ? 1 : multiplicity[i];
+        }
+
+        void set_neighbors(vector<vertex_id_type> &ids, bool directed, size_t num_edges) {
+            sort(ids.begin(), ids.end());
+
+            neighbors.clear();
+            multiplicity.clear();
+
+            for (size_t i = 0; i < ids.size(); i++) {
+                if (i > 0 && ids[i] == ids[i - 1]) {
+                    if (directed && multiplicity.back() < numeric_limits<uint8_t>::max()) {
+                        multiplicity.back()++;
+                    }
+                } else {
+                    neighbors.push_back(ids[i]);
+                    if (directed) multiplicity.push_back(1);
+                }
+            }
+
+            degree = neighbors.size();
+            hub = num_edges >= global_hub_threshold;
+
+            if (global_compress) {
+                intersect::encode_deltas(neighbors.data(),
+                        directed ? multiplicity.data() : NULL,
+                        neighbors.size(), encoded);
+                vector<uint8_t>(encoded).swap(encoded);
+                vector<vertex_id_type>().swap(neighbors);
+                vector<uint8_t>().swap(multiplicity);
+            } else {
+                vector<vertex_id_type>(neighbors).swap(neighbors);
+                vector<uint8_t>(multiplicity).swap(multiplicity);
+            }
+
+            build_index();
+        }
+
+        void build_index() {
+            if (hub && size() > 0) {
+                if (!is_decoded()) {
+                    decode();
+                }
+
+                hub_index.build(neighbors.data(), neighbors.size());
+            } else {
+                hub_index.clear();
+            }
+        }
+
+        void decode() {
+            neighbors.clear();
+            multiplicity.clear();
+
+            intersect::delta_decoder<vertex_id_type> it(encoded.data(), global_directed);
+
+            for (; it.valid(); it.next()) {
+                neighbors.push_back(it.item());
+                if (global_directed) multiplicity.push_back(it.tag() + 1);
+            }
+        }
+
+        size_t num_edges_to(vertex_id_type id) const {
+            if (!is_decoded()) {
+                intersect::delta_decoder<vertex_id_type> it(encoded.data(), global_directed);
+
+                while (it.valid() && it.item() < id) {
+                    it.next();
+                }
+
+                return it.valid() && it.item() == id ? it.tag() + 1 : 0;
+            }
+
+            vector<vertex_id_type>::const_iterator it = lower_bound(neighbors.begin(), neighbors.end(), id);
+
+            if (it == neighbors.end() || *it != id) {
+                return 0;
+            }
+
+            return multiplicity_at(it - neighbors.begin());
+        }
+
+        size_t memory_usage() const {
+            return neighbors.capacity() * sizeof(vertex_id_type)
+                 + multiplicity.capacity() * sizeof(uint8_t)
+                 + encoded.capacity() * sizeof(uint8_t)
+                 + flags.capacity() * sizeof(uint8_t)
+                 + hub_index.memory_usage();
+        }
+
+        void clear_neighbors() {
+            vector<vertex_id_type>().swap(neighbors);
+            vector<uint8_t>().swap(multiplicity);
+            vector<uint8_t>().swap(encoded);
+            vector<uint8_t>().swap(flags);
+            hub_index.clear();
+        }
+
+        void save(graphlab::oarchive& oarc) const {
+            oarc << degree << hub;
+
+            size_t n = size();
+            size_t plain_bytes = sizeof(size_t) + n * sizeof(vertex_id_type)
+                               + sizeof(size_t) + (global_directed ? n : 0);
+            size_t sent_bytes;
+
+            if (compression::enabled()) {
+                if (global_compress) {
+                    sent_bytes = compression::save_vector(oarc, encoded);
+                } else {
+                    sent_bytes = compression::save_vector(oarc, neighbors)
+                               + compression::save_vector(oarc, multiplicity);
+                }
+            } else if (global_compress) {
+                oarc << encoded;
+                sent_bytes = sizeof(size_t) + encoded.size();
+            } else {
+                oarc << neighbors << multiplicity;
+                sent_bytes = plain_bytes;
+            }
+
+            if (global_count_sent) {
+                global_sent_bytes += sent_bytes;
+                global_sent_plain_bytes += plain_bytes;
+            }
+
+            if (global_sample_size > 0) {
+                oarc << flags;
+            }
+        }
+
+        void load(graphlab::iarchive& iarc) {
+            iarc >> degree >> hub;
+
+            if (global_compress) {
+                if (compression::enabled()) {
+                    compression::load_vector(iarc, encoded);
+                } else {
+                    iarc >> encoded;
+                }
+
+                neighbors.clear();
+                multiplicity.clear();
+            } else if (compression::enabled()) {
+                compression::load_vector(iarc, neighbors);
+                compression::load_vector(iarc, multiplicity);
+            } else {
+                iarc >> neighbors >> multiplicity;
+            }
+
+            if (global_sample_size > 0) {
+                iarc >> flags;
+            }
+
+            build_index();
+        }
+};
+
+// Iterates over the neighbors of a vertex, decoding them on the fly if needed.
+class neighbor_cursor {
+    public:
+        neighbor_cursor(const vertex_data_type &data) :
+                data(data),
+                decoded(data.is_decoded()),
+                pos(0),
+                decoder(decoded ? EMPTY_LIST : data.encoded.data(), global_directed) {
+            //
+        }
+
+        bool valid() const {
+            return decoded ? pos < data.neighbors.size() : decoder.valid();
+        }
+
+        vertex_id_type item() const {
+            return decoded ? data.neighbors[pos] : decoder.item();
+        }
+
+        size_t multiplicity() const {
+            return decoded ? data.multiplicity_at(pos) : decoder.tag() + 1;
+        }
+
+        void next() {
+            if (decoded) {
+                pos++;
+            } else {
+                decoder.next();
+            }
+        }
+
+    private:
+        static const uint8_t EMPTY_LIST[1];
+
+        const vertex_data_type &data;
+        const bool decoded;
+        size_t pos;
+        intersect::delta_decoder<vertex_id_type> decoder;
+};
+
+const uint8_t neighbor_cursor::EMPTY_LIST[1] = {0};
+
+// Time spent in and number of intersections for both paths. Every thread
+// updates its own instance, they are only summed when reported. Only one in
+// STATS_SAMPLE_INTERVAL intersections of a thread is timed, and its time is
+// counted that many times.
+static const uint64_t STATS_SAMPLE_INTERVAL = 64;
+
+struct intersect_stats {
+    uint64_t list_nsec;
+    uint64_t list_calls;
+    uint64_t hub_nsec;
+    uint64_t hub_calls;
+    uint64_t ticks;
+};
+
+static std::mutex global_stats_mutex;
+static vector<intersect_stats*> global_stats;
+
+intersect_stats& local_stats() {
+    static thread_local intersect_stats *stats = NULL;
+
+    if (stats == NULL) {
+        stats = new intersect_stats();
+        std::lock_guard<std::mutex> guard(global_stats_mutex);
+        global_stats.push_back(stats);
+    }
+
+    return *stats;
+}
+
+// Measures the time of an intersection if it is one of the sampled ones,
+// elapsed() returns the scaled time or 0 otherwise.
+class intersect_timer {
+    typedef std::chrono::steady_clock clock;
+
+    bool timed;
+    clock::time_point before;
+
+public:
+    intersect_timer(intersect_stats &stats) :
+        timed(stats.ticks++ % STATS_SAMPLE_INTERVAL == 0) {
+        if (timed) {
+            before = clock::now();
+        }
+    }
+
+    uint64_t elapsed() const {
+        if (!timed) {
+            return 0;
+        }
+
+        uint64_t nsec = std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - before).count();
+        return nsec * STATS_SAMPLE_INTERVAL;
+    }
+};
+
+// Adapts match(c, a_multiplicity, b_multiplicity) to the position based
+// callbacks of the kernels in intersect.hpp.
+template <typename F>
+struct position_match {
+    const vertex_data_type &a;
+    const vertex_data_type &b;
+    F &match;
+
+    position_match(const vertex_data_type &a, const vertex_data_type &b, F &match) :
+        a(a), b(b), match(match) {
+        //
+    }
+
+    void operator()(size_t i, size_t j) {
+        match(a.neighbors[i], a.multiplicity_at(i), b.multiplicity_at(j));
+    }
+};
+
+template <typename F>
+struct swapped_match {
+    F &match;
+
+    swapped_match(F &match) : match(match) {
+        //
+    }
+
+    void operator()(vertex_id_type c, size_t a_mult, size_t b_mult) {
+        match(c, b_mult, a_mult);
+    }
+};
+
+template <typename F>
+void probe_hub(const vertex_data_type &a, const vertex_data_type &hub, F &match) {
+    size_t j;
+
+    for (neighbor_cursor it(a); it.valid(); it.next()) {
+        if (hub.hub_index.find(it.item(), j)) {
+            match(it.item(), it.multiplicity(), hub.multiplicity_at(j));
+        }
+    }
+}
+
+template <typename F>
+void merge_cursors(const vertex_data_type &a, const vertex_data_type &b, F &match) {
+    neighbor_cursor it_a(a);
+    neighbor_cursor it_b(b);
+
+    while (it_a.valid() && it_b.valid()) {
+        if (it_a.item() < it_b.item()) {
+            it_a.next();
+        } else if (it_a.item() > it_b.item()) {
+            it_b.next();
+        } else {
+            match(it_a.item(), it_a.multiplicity(), it_b.multiplicity());
+            it_a.next();
+            it_b.next();
+        }
+    }
+}
+
+// Calls match(c, a_mult, b_mult) for every common neighbor c of a and b, where
+// a_mult and b_mult are the number of edges connecting c to a and b.
+// Intersections involving a hub are done by probing the index of the hub
+// with the neighbors of the other vertex. Otherwise, decoded lists are
+// intersected by the kernels in intersect.hpp and compressed lists are merged
+// while decoding them.
+template <typename F>
+void intersect_neighbors(const vertex_data_type &a, const vertex_data_type &b, F &match) {
+    intersect_stats &stats = local_stats();
+    intersect_timer timer(stats);
+    bool hub = true;
+
+    if (!b.hub_index.empty() && a.size() <= b.size()) {
+        probe_hub(a, b, match);
+    } else if (!a.hub_index.empty() && b.size() <= a.size()) {
+        swapped_match<F> m(match);
+        probe_hub(b, a, m);
+    } else if (a.is_decoded() && b.is_decoded()) {
+        position_match<F> m(a, b, match);
+        intersect::sorted(a.neighbors.data(), a.neighbors.size(),
+                          b.neighbors.data(), b.neighbors.size(), m);
+        hub = false;
+    } else {
+        merge_cursors(a, b, match);
+        hub = false;
+    }
+
+    uint64_t nsec = timer.elapsed();
+
+    if (hub) {
+        stats.hub_nsec += nsec;
+        stats.hub_calls++;
+    } else {
+        stats.list_nsec += nsec;
+        stats.list_calls++;
+    }
+}
+
+// Degree histogram with bucket i holding the number of vertices with a degree in [2^i, 2^(i+1))
+struct degree_histogram {
+    size_t buckets[64];
+
+    degree_histogram() {
+        fill(buckets, buckets + 64, 0);
+    }
+
+    degree_histogram& operator +=(const degree_histogram& other) {
+        for (size_t i = 0; i < 64; i++) {
+            buckets[i] += other.buckets[i];
+        }
+
+        return *this;
+    }
+
+    void save(graphlab::oarchive& oarc) const {
+        oarc.write((const char*) buckets, sizeof(buckets));
+    }
+
+    void load(graphlab::iarchive& iarc) {
+        iarc.read((char*) buckets, sizeof(buckets));
+    }
+};
+
+degree_histogram vertex_degree(const graph_type::vertex_type &vertex) {
+    size_t degree = vertex.num_in_edges() + vertex.num_out_edges();
+    degree_histogram h;
+
+    if (degree > 0) {
+        h.buckets[63 - __builtin_clzll(degree)] = 1;
+    }
+
+    return h;
+}
+
+// Picks the smallest power of two (but at least MIN_HUB_THRESHOLD) such that at
+// most HUB_FRACTION of all vertices have a higher degree. In skewed graphs,
+// these few vertices are involved in the bulk of the expensive intersections,
+// while the memory needed for their indices remains limited.
+const size_t MIN_HUB_THRESHOLD = 256;
+const double HUB_FRACTION = 0.01;
+
+size_t pick_hub_threshold(graph_type &graph) {
+    degree_histogram h = graph.map_reduce_vertices<degree_histogram>(vertex_degree);
+    size_t max_hubs = size_t(HUB_FRACTION * graph.num_vertices());
+    size_t hubs = 0;
+    size_t i = 63;
+
+    while (i > 0 && hubs + h.buckets[i - 1] <= max_hubs) {
+        hubs += h.buckets[i - 1];
+        i--;
+    }
+
+    return max(MIN_HUB_THRESHOLD, size_t(1) << i);
+}
+
+// Results are only written to the output, so they are kept by the master of
+// every vertex instead of in the vertex data, which is sent to all mirrors.
+// The final apply also drops the neighbor lists, which are no longer needed,
+// so the vertex data synchronized after it is small.
+static vertex_column<double> global_clustering_coef;
+
+double clustering_coefficient(size_t d, size_t t) {
+    // Due to rounding errors, the results is sometimes not exactly
+    // 0.0 even when it should be. Explicitly set LCC to 0 if that
+    // is the case, other calculate it as tri / (degree * (degree - 1))
+    return (d < 2 || t == 0) ? 0.0 : double(t) / (d * (d - 1));
+}
+
+// Called for every common neighbor c of a and b. Vertex a is credited with the
+// number of edges between b and c, vertex b with those between a and c. Each
+// pair of neighbors is only credited once by requiring it to be ordered by id.
+// In undirected graphs, every neighbor is connected through two edges.
+template <bool directed>
+struct triangle_match {
+    const vertex_id_type a_id;
+    const vertex_id_type b_id;
+    size_t a_count;
+    size_t b_count;
+
+    triangle_match(vertex_id_type a_id, vertex_id_type b_id) :
+        a_id(a_id), b_id(b_id), a_count(0), b_count(0) {
+        //
+    }
+
+    void operator()(vertex_id_type c_id, size_t a_mult, size_t b_mult) {
+        if (b_id < c_id) {
+            a_count += directed ? b_mult : 2;
+        }
+
+        if (a_id < c_id) {
+            b_count += directed ? a_mult : 2;
+        }
+    }
+};
+
+// Number of edges between a and b, which both store all of their neighbors.
+// The lookup uses a decoded list if there is one, and otherwise decodes the
+// shorter list, so it never costs more than the intersection of both lists.
+size_t num_edges_between(vertex_id_type a_id, const vertex_data_type &a,
+                         vertex_id_type b_id, const vertex_data_type &b) {
+    if (a.is_decoded()) {
+        return a.num_edges_to(b_id);
+    } else if (b.is_decoded() || b.size() < a.size()) {
+        return b.num_edges_to(a_id);
+    } else {
+        return a.num_edges_to(b_id);
+    }
+}
+
+template <bool directed>
+pair<size_t, size_t> count_triangles(vertex_id_type a_id, const vertex_data_type &a,
+                                     vertex_id_type b_id, const vertex_data_type &b) {
+
+    // In directed graphs, neighbors connected in both directions are visited
+    // twice. Only count triangles for one of the two edges.
+    if (directed && a_id < b_id && num_edges_between(a_id, a, b_id, b) > 1) {
+        return make_pair(0, 0);
+    }
+
+    triangle_match<directed> match(a_id, b_id);
+    intersect_neighbors(a, b, match);
+
+    return make_pair(match.a_count, match.b_count);
+}
+
+// The vertex programs are instantiated for directed and undirected graphs, so
+// the intersections do not need to test the direction for every match.
+template <bool directed>
+class triangle_count :
+    public graphlab::ivertex_program<graph_type, gather_type, msg_type>,
+    public graphlab::IS_POD_TYPE {
+
+    public:
+        msg_type last_msg;
+
+        void init(icontext_type& context, const vertex_type& vertex, const msg_type& msg) {
+            last_msg = msg;
+        }
+
+        edge_dir_type gather_edges(icontext_type& context, const vertex_type& vertex) const {
+            if (context.iteration() == 0) {
+                return graphlab::ALL_EDGES;
+            } else {
+                return graphlab::NO_EDGES;
+            }
+        }
+
+        gather_type gather(icontext_type& context, const vertex_type& vertex, edge_type& edge) const {
+            if (context.iteration() == 0) {
+                if (vertex.id() == edge.source().id()) {
+                    return gather_type(edge.target().id());
+                } else {
+                    return gather_type(edge.source().id());
+                }
+            } else {
+                return gather_type();
+            }
+        }
+
+        void apply(icontext_type& context, vertex_type& vertex, const gather_type &total) {
+            if (context.iteration() == 0) {
+                vector<vertex_id_type> ids(total.ids);
+                vertex.data().set_neighbors(ids, directed, vertex.num_in_edges() + vertex.num_out_edges());
+                global_neighbors_bytes += vertex.data().memory_usage();
+            } else {
+                global_clustering_coef[vertex] = clustering_coefficient(vertex.data().degree, last_msg);
+                vertex.data().clear_neighbors();
+            }
+        }
+
+        edge_dir_type scatter_edges(icontext_type& context, const vertex_type& vertex) const {
+            if (context.iteration() == 0) {
+                return graphlab::OUT_EDGES;
+            } else {
+                return graphlab::NO_EDGES;
+            }
+        }
+
+        void scatter(icontext_type& context, const vertex_type& vertex, edge_type& edge) const {
+            if (context.iteration() == 0) {
+                pair<size_t, size_t> p = count_triangles<directed>(
+                        edge.source().id(), edge.source().data(),
+                        edge.target().id(), edge.target().data());
+
+                if (p.first > 0) {
+                    context.signal(edge.source(), p.first);
+                }
+
+                if (p.second > 0) {
+                    context.signal(edge.target(), p.second);
+                }
+            } else {
+                //
+            }
+        }
+};
+
+// Vertices are ordered by degree and ties are broken by id. Edges are
+// oriented from the lower ranked to the higher ranked endpoint.
+template <typename V>
+bool precedes(const V &a, const V &b) {
+    size_t a_degree = a.num_in_edges() + a.num_out_edges();
+    size_t b_degree = b.num_in_edges() + b.num_out_edges();
+
+    return a_degree < b_degree || (a_degree == b_degree && a.id() < b.id());
+}
+
+// Called for every common forward neighbor w of the edge (u, v). Every vertex
+// of the triangle is credited with the number of edges between the other two.
+template <typename C, bool directed>
+struct forward_match {
+    C &context;
+    const size_t uv_count;
+    size_t u_count;
+    size_t v_count;
+
+    forward_match(C &context, size_t uv_count) :
+        context(context), uv_count(uv_count), u_count(0), v_count(0) {
+        //
+    }
+
+    void operator()(vertex_id_type w_id, size_t u_mult, size_t v_mult) {
+        u_count += directed ? v_mult : 2;
+        v_count += directed ? u_mult : 2;
+        context.signal_vid(w_id, uv_count);
+    }
+};
+
+// Variant which only stores the neighbors of a vertex which are ranked higher
+// (see precedes). Every triangle is found exactly once, from its lowest
+// ranked edge, and the work per edge is bounded by the smaller forward degree.
+template <bool directed>
+class forward_triangle_count :
+    public graphlab::ivertex_program<graph_type, gather_type, msg_type>,
+    public graphlab::IS_POD_TYPE {
+
+    public:
+        msg_type last_msg;
+
+        void init(icontext_type& context, const vertex_type& vertex, const msg_type& msg) {
+            last_msg = msg;
+        }
+
+        edge_dir_type gather_edges(icontext_type& context, const vertex_type& vertex) const {
+            return context.iteration() == 0 ? graphlab::ALL_EDGES : graphlab::NO_EDGES;
+        }
+
+        gather_type gather(icontext_type& context, const vertex_type& vertex, edge_type& edge) const {
+            const vertex_type& other = edge.source().id() == vertex.id() ? edge.target() : edge.source();
+            return gather_type(other.id(), !precedes(vertex, other));
+        }
+
+        void apply(icontext_type& context, vertex_type& vertex, const gather_type &total) {
+            if (context.iteration() == 0) {
+                vector<vertex_id_type> ids(total.ids);
+                vertex.data().set_neighbors(ids, directed, vertex.num_in_edges() + vertex.num_out_edges());
+                global_neighbors_bytes += vertex.data().memory_usage();
+
+                vector<vertex_id_type> backward_ids(total.backward_ids);
+                sort(backward_ids.begin(), backward_ids.end());
+                vertex.data().degree += unique(backward_ids.begin(), backward_ids.end()) - backward_ids.begin();
+            } else {
+                global_clustering_coef[vertex] = clustering_coefficient(vertex.data().degree, last_msg);
+                vertex.data().clear_neighbors();
+            }
+        }
+
+        edge_dir_type scatter_edges(icontext_type& context, const vertex_type& vertex) const {
+            return context.iteration() == 0 ? graphlab::ALL_EDGES : graphlab::NO_EDGES;
+        }
+
+        void scatter(icontext_type& context, const vertex_type& vertex, edge_type& edge) const {
+            const bool outgoing = edge.source().id() == vertex.id();
+            const vertex_type& other = outgoing ? edge.target() : edge.source();
 
-        vertex_data_type() {
-            clustering_coef = 0.0;
-        }
+            if (!precedes(vertex, other)) {
+                return;
+            }
 
-        void save(graphlab::oarchive& oarc) const {
-            oarc << clustering_coef << neighbors;
-        }
+            // Neighbors connected in both directions are visited twice, only
+            // count triangles for the outgoing edge. Only the list of u holds
+            // the edge, and a compressed list of u is decoded by the
+            // intersection as well, so the lookup does not add to its cost.
+            size_t uv_count = vertex.data().num_edges_to(other.id());
 
-        void load(graphlab::iarchive& iarc) {
-            iarc >> clustering_coef >> neighbors;
+            if (uv_count > 1 && !outgoing) {
+                return;
+            }
+
+            const vertex_data_type &u = vertex.data();
+            const vertex_data_type &v = other.data();
+
+            forward_match<icontext_type, directed> match(context, directed ? uv_count : 2);
+            intersect_neighbors(u, v, match);
+
+            if (match.u_count > 0) {
+                context.signal(vertex, match.u_count);
+            }
+
+            if (match.v_count > 0) {
+                context.signal(other, match.v_count);
+            }
         }
 };
 
-static bool global_directed;
+// Variant which bounds the memory used for neighbor lists by counting
+// triangles in multiple rounds. In round r, vertices only store their
+// neighbors whose id hashes to r, so only triangles having such a neighbor as
+// apex are found: every edge (b, c) credits the common neighbors of b and c.
+// Degrees and triangle counts are accumulated across rounds in global_partial.
+static size_t global_num_rounds;
+static size_t global_round;
+static vertex_column<pair<size_t, size_t> > global_partial;
 
-class triangle_count :
+bool in_round(vertex_id_type id) {
+    return id % global_num_rounds == global_round;
+}
+
+template <typename C>
+struct apex_match {
+    C &context;
+    const size_t count;
+
+    apex_match(C &context, size_t count) :
+        context(context), count(count) {
+        //
+    }
+
+    void operator()(vertex_id_type a_id, size_t b_mult, size_t c_mult) {
+        context.signal_vid(a_id, count);
+    }
+};
+
+template <bool directed>
+class partitioned_triangle_count :
     public graphlab::ivertex_program<graph_type, gather_type, msg_type>,
     public graphlab::IS_POD_TYPE {
 
@@ -69,20 +865,251 @@ class triangle_count :
         }
 
         edge_dir_type gather_edges(icontext_type& context, const vertex_type& vertex) const {
+            return context.iteration() == 0 ? graphlab::ALL_EDGES : graphlab::NO_EDGES;
+        }
+
+        gather_type gather(icontext_type& context, const vertex_type& vertex, edge_type& edge) const {
+            const vertex_type& other = edge.source().id() == vertex.id() ? edge.target() : edge.source();
+            return in_round(other.id()) ? gather_type(other.id()) : gather_type();
+        }
+
+        void apply(icontext_type& context, vertex_type& vertex, const gather_type &total) {
+            pair<size_t, size_t> &partial = global_partial[vertex];
+
             if (context.iteration() == 0) {
-                return graphlab::ALL_EDGES;
+                vector<vertex_id_type> ids(total.ids);
+                vertex.data().set_neighbors(ids, directed, vertex.num_in_edges() + vertex.num_out_edges());
+                global_neighbors_bytes += vertex.data().memory_usage();
+                partial.first += vertex.data().degree;
             } else {
-                return graphlab::NO_EDGES;
+                partial.second += last_msg;
+                vertex.data().clear_neighbors();
             }
         }
 
+        edge_dir_type scatter_edges(icontext_type& context, const vertex_type& vertex) const {
+            return context.iteration() == 0 ? graphlab::OUT_EDGES : graphlab::NO_EDGES;
+        }
+
+        // Every directed edge is visited once, so an apex is credited twice
+        // for neighbors connected in both directions, as required.
+        void scatter(icontext_type& context, const vertex_type& vertex, edge_type& edge) const {
+            const vertex_data_type &b = edge.source().data();
+            const vertex_data_type &c = edge.target().data();
+
+            apex_match<icontext_type> match(context, directed ? 1 : 2);
+            intersect_neighbors(b, c, match);
+        }
+};
+
+void finish_rounds(graph_type::vertex_type &vertex) {
+    const pair<size_t, size_t> &partial = global_partial[vertex];
+    vertex.data().degree = partial.first;
+    global_clustering_coef[vertex] = clustering_coefficient(partial.first, partial.second);
+}
+
+// Approximate variant for graphs on which the neighbor lists do not fit. A
+// hub (a vertex with more than global_sample_size edges) samples each of its
+// neighbors with probability sample_rate(vertex), picked by a hash of both
+// ids, other vertices keep all of them. Its coefficient is estimated from the
+// pairs of sampled neighbors, with a normal confidence interval from the
+// variance over the sample, scaled by the fraction of neighbors not sampled.
+//
+// Hubs also keep their hub neighbors with a higher id, so whether two
+// neighbors u and c are connected is known exactly from the list of u if u is
+// not a hub, or if both are hubs and u has the lower id. Each pair is counted
+// from a side that knows it, half from both if both do. Non-hubs therefore
+// get their exact coefficient and an empty interval, and a hub keeps about
+// global_sample_size neighbors plus its edges to other hubs.
+struct estimate : public graphlab::IS_POD_TYPE {
+    double value;
+    double low;
+    double high;
+};
+
+static vertex_column<estimate> global_estimates;
+
+// Two-sided 95% confidence intervals
+const double CONFIDENCE_Z = 1.96;
+
+// Bits of vertex_data_type::flags, whether the neighbor is in the sample of
+// the vertex and whether it is a hub
+const uint8_t SAMPLED_NEIGHBOR = 1;
+const uint8_t HUB_NEIGHBOR = 2;
+
+template <typename V>
+bool is_hub(const V &vertex) {
+    return vertex.num_in_edges() + vertex.num_out_edges() > global_sample_size;
+}
+
+template <typename V>
+double sample_rate(const V &vertex) {
+    return is_hub(vertex) ? double(global_sample_size) / (vertex.num_in_edges() + vertex.num_out_edges()) : 1.0;
+}
+
+// Whether vertex a keeps neighbor b in its sample. The decision only depends
+// on both ids, so it is the same for every edge between them.
+bool sampled(vertex_id_type a, vertex_id_type b, double rate) {
+    if (rate >= 1.0) {
+        return true;
+    }
+
+    uint64_t x = (uint64_t(a) << 32) ^ uint64_t(b);
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+    x = x ^ (x >> 31);
+
+    return (x >> 11) * (1.0 / (uint64_t(1) << 53)) < rate;
+}
+
+// Marks the sampled and the hub neighbors in the list of a vertex, and sets
+// its degree to the number of sampled neighbors
+void set_sample_flags(vertex_id_type id, double rate, vector<vertex_id_type> &hubs, vertex_data_type &data) {
+    sort(hubs.begin(), hubs.end());
+
+    data.flags.assign(data.neighbors.size(), 0);
+    data.degree = 0;
+
+    for (size_t i = 0; i < data.neighbors.size(); i++) {
+        if (sampled(id, data.neighbors[i], rate)) {
+            data.flags[i] |= SAMPLED_NEIGHBOR;
+            data.degree++;
+        }
+
+        if (binary_search(hubs.begin(), hubs.end(), data.neighbors[i])) {
+            data.flags[i] |= HUB_NEIGHBOR;
+        }
+    }
+}
+
+// Intersects the neighbor lists of the approximate variant, which are short
+// and never compressed, calling match(i, j) for every common neighbor at
+// position i in a and j in b.
+template <typename F>
+void intersect_samples(const vertex_data_type &a, const vertex_data_type &b, F &match) {
+    intersect_stats &stats = local_stats();
+    intersect_timer timer(stats);
+
+    intersect::sorted(a.neighbors.data(), a.neighbors.size(),
+                      b.neighbors.data(), b.neighbors.size(), match);
+
+    stats.list_nsec += timer.elapsed();
+    stats.list_calls++;
+}
+
+// Sum and sum of squares of Y_u over the sampled neighbors
+struct sample_moments : public graphlab::IS_POD_TYPE {
+    double sum;
+    double sum_sq;
+
+    sample_moments() : sum(0), sum_sq(0) {
+        //
+    }
+
+    explicit sample_moments(double y) : sum(y), sum_sq(y * y) {
+        //
+    }
+
+    sample_moments& operator +=(const sample_moments& other) {
+        sum += other.sum;
+        sum_sq += other.sum_sq;
+        return *this;
+    }
+};
+
+// Share of the pair of neighbors u and c which is counted from the side of u
+double pair_share(vertex_id_type u_id, bool u_is_hub, vertex_id_type c_id, bool c_is_hub) {
+    if (u_is_hub) {
+        return c_is_hub && u_id < c_id ? 1.0 : 0.0;
+    } else {
+        return c_is_hub ? 1.0 : 0.5;
+    }
+}
+
+// Called for every common neighbor c of the endpoints a and b of an edge. If
+// a sampled b, it sums the edges between b and c for the pairs in the sample
+// of a, weighted by the share of the pair counted from the side of b, and
+// the other way around.
+template <bool directed>
+struct sample_match {
+    const vertex_data_type &a;
+    const vertex_data_type &b;
+    const vertex_id_type a_id;
+    const vertex_id_type b_id;
+    const bool a_is_hub;
+    const bool b_is_hub;
+    const bool a_sampled_b;
+    const bool b_sampled_a;
+    double a_edges;
+    double b_edges;
+
+    sample_match(const vertex_data_type &a, const vertex_data_type &b,
+                 vertex_id_type a_id, vertex_id_type b_id, bool a_is_hub, bool b_is_hub,
+                 bool a_sampled_b, bool b_sampled_a) :
+        a(a), b(b), a_id(a_id), b_id(b_id), a_is_hub(a_is_hub), b_is_hub(b_is_hub),
+        a_sampled_b(a_sampled_b), b_sampled_a(b_sampled_a), a_edges(0), b_edges(0) {
+        //
+    }
+
+    void operator()(size_t i, size_t j) {
+        vertex_id_type c_id = a.neighbors[i];
+
+        if (a_sampled_b && (a.flags[i] & SAMPLED_NEIGHBOR)) {
+            a_edges += pair_share(b_id, b_is_hub, c_id, a.flags[i] & HUB_NEIGHBOR)
+                     * (directed ? b.multiplicity_at(j) : 2);
+        }
+
+        if (b_sampled_a && (b.flags[j] & SAMPLED_NEIGHBOR)) {
+            b_edges += pair_share(a_id, a_is_hub, c_id, b.flags[j] & HUB_NEIGHBOR)
+                     * (directed ? a.multiplicity_at(i) : 2);
+        }
+    }
+};
+
+// Every sampled neighbor u contributes Y_u, the edges to the other sampled
+// neighbors counted from its side divided by s - 1, so the coefficient is the
+// mean of Y_u over the s sampled neighbors. As every pair is shared by two
+// neighbors, the variance of the mean is about four times var(Y) / s, and
+// none of it remains if all neighbors are sampled.
+estimate estimate_coefficient(size_t s, double rate, const sample_moments &moments) {
+    estimate e = estimate();
+
+    if (s < 2) {
+        return e;
+    }
+
+    double mean = moments.sum / s;
+    double variance = max(moments.sum_sq / s - mean * mean, 0.0) * s / (s - 1);
+    double half_width = CONFIDENCE_Z * 2 * sqrt(variance / s * (1.0 - rate));
+
+    e.value = min(mean, 1.0);
+    e.low = max(e.value - half_width, 0.0);
+    e.high = min(e.value + half_width, 1.0);
+    return e;
+}
+
+template <bool directed>
+class sampled_triangle_count :
+    public graphlab::ivertex_program<graph_type, gather_type, sample_moments>,
+    public graphlab::IS_POD_TYPE {
+
+    public:
+        sample_moments last_msg;
+
+        void init(icontext_type& context, const vertex_type& vertex, const sample_moments& msg) {
+            last_msg = msg;
+        }
+
+        edge_dir_type gather_edges(icontext_type& context, const vertex_type& vertex) const {
+            return context.iteration() == 0 ? graphlab::ALL_EDGES : graphlab::NO_EDGES;
+        }
+
         gather_type gather(icontext_type& context, const vertex_type& vertex, edge_type& edge) const {
-            if (context.iteration() == 0) {
-                if (vertex.id() == edge.source().id()) {
-                    return gather_type(edge.target().id());
-                } else {
-                    return gather_type(edge.source().id());
-                }
+            const vertex_type& other = edge.source().id() == vertex.id() ? edge.target() : edge.source();
+
+            if (sampled(vertex.id(), other.id(), sample_rate(vertex))
+                    || (is_hub(other) && vertex.id() < other.id())) {
+                return gather_type(other.id(), is_hub(other));
             } else {
                 return gather_type();
             }
@@ -90,91 +1117,193 @@ class triangle_count :
 
         void apply(icontext_type& context, vertex_type& vertex, const gather_type &total) {
             if (context.iteration() == 0) {
-                vertex.data().neighbors = total.get();
-            } else {
-                size_t d = vertex.data().neighbors.size();
-                size_t t = last_msg;
-
-                // Due to rounding errors, the results is sometimes not exactly
-                // 0.0 even when it should be. Explicitly set LCC to 0 if that
-                // is the case, other calculate it as tri / (degree * (degree - 1))
-                double lcc = (d < 2 || t == 0) ? 0.0 : double(t) / (d * (d - 1));
+                vector<vertex_id_type> ids(total.ids);
+                vector<vertex_id_type> hubs(total.backward_ids);
+                ids.insert(ids.end(), hubs.begin(), hubs.end());
 
-                vertex.data().clustering_coef = lcc;
+                vertex.data().set_neighbors(ids, directed, vertex.num_in_edges() + vertex.num_out_edges());
+                set_sample_flags(vertex.id(), sample_rate(vertex), hubs, vertex.data());
+                global_neighbors_bytes += vertex.data().memory_usage();
+            } else {
+                global_estimates[vertex] = estimate_coefficient(vertex.data().degree, sample_rate(vertex), last_msg);
+                vertex.data().clear_neighbors();
             }
         }
 
         edge_dir_type scatter_edges(icontext_type& context, const vertex_type& vertex) const {
-            if (context.iteration() == 0) {
-                return graphlab::OUT_EDGES;
-            } else {
-                return graphlab::NO_EDGES;
-            }
+            return context.iteration() == 0 ? graphlab::OUT_EDGES : graphlab::NO_EDGES;
         }
 
-        pair<size_t, size_t> count_triangles(const vertex_type& a, const vertex_type& b, const bool inverted=false) const {
-            typedef neighbors_type::const_iterator neighbors_iterator_type;
+        // Every edge is visited once, and credits both endpoints. Neighbors
+        // connected in both directions are only counted for the edge from
+        // the lower id.
+        void scatter(icontext_type& context, const vertex_type& vertex, edge_type& edge) const {
+            const vertex_type &a = edge.source();
+            const vertex_type &b = edge.target();
+            const vertex_data_type &a_data = a.data();
+            const vertex_data_type &b_data = b.data();
+
+            bool a_sampled_b = a_data.degree >= 2 && sampled(a.id(), b.id(), sample_rate(a));
+            bool b_sampled_a = b_data.degree >= 2 && sampled(b.id(), a.id(), sample_rate(b));
 
-            const vertex_id_type a_id = a.id();
-            const vertex_id_type b_id = b.id();
+            if (!a_sampled_b && !b_sampled_a) {
+                return;
+            }
 
-            const neighbors_type& a_adj = a.data().neighbors;
-            const neighbors_type& b_adj = b.data().neighbors;
+            if (directed && a.id() > b.id()
+                    && max(a_data.num_edges_to(b.id()), b_data.num_edges_to(a.id())) > 1) {
+                return;
+            }
 
-            const bool directed = global_directed;
+            sample_match<directed> match(a_data, b_data, a.id(), b.id(), is_hub(a), is_hub(b),
+                                         a_sampled_b, b_sampled_a);
+            intersect_samples(a_data, b_data, match);
 
-            if (a_adj.at(b_id) > 1 && a.id() < b.id() && !inverted) {
-                return make_pair(0, 0);
+            if (match.a_edges > 0) {
+                context.signal(a, sample_moments(match.a_edges / (a_data.degree - 1)));
             }
 
-            if (a_adj.size() > b_adj.size()) {
-                return reverse(count_triangles(b, a, true));
+            if (match.b_edges > 0) {
+                context.signal(b, sample_moments(match.b_edges / (b_data.degree - 1)));
             }
+        }
+};
 
-            size_t a_count = 0;
-            size_t b_count = 0;
+// Number of vertices with a sampled neighbor list, and the sum of the widths
+// of their intervals
+struct sample_summary : public graphlab::IS_POD_TYPE {
+    size_t vertices;
+    double width;
 
-            for (neighbors_iterator_type it_a = a_adj.begin(); it_a != a_adj.end(); it_a++) {
-                const vertex_id_type c_id = it_a->first;
-                neighbors_iterator_type it_b = b_adj.find(it_a->first);
+    sample_summary() : vertices(0), width(0) {
+        //
+    }
 
-                if (it_b != b_adj.end()) {
-                    if (b_id < c_id) {
-                        a_count += directed ? it_b->second : 2;
-                    }
+    sample_summary& operator +=(const sample_summary& other) {
+        vertices += other.vertices;
+        width += other.width;
+        return *this;
+    }
+};
 
-                    if (a_id < c_id) {
-                        b_count += directed ? it_a->second : 2;
-                    }
-                }
-            }
+sample_summary summarize_sample(const graph_type::vertex_type &vertex) {
+    sample_summary summary;
 
-            return make_pair(a_count, b_count);
-        }
+    if (sample_rate(vertex) < 1.0) {
+        const estimate &e = global_estimates[vertex];
+        summary.vertices = 1;
+        summary.width = e.high - e.low;
+    }
 
-        void scatter(icontext_type& context, const vertex_type& vertex, edge_type& edge) const {
-            if (context.iteration() == 0) {
-                pair<size_t, size_t> p = count_triangles(edge.source(), edge.target());
+    return summary;
+}
 
-                if (p.first > 0) {
-                    context.signal(edge.source(), p.first);
-                }
+// Rough estimate of the memory needed per rank for the neighbor lists of all
+// replicas: every replica stores its full list, and lists are first
+// collected by the gather before they are compacted in apply.
+size_t estimate_neighbors_memory(size_t num_edges, double replication, size_t num_procs) {
+    double entry_bytes = sizeof(vertex_id_type) + (global_directed ? sizeof(uint8_t) : 0);
 
-                if (p.second > 0) {
-                    context.signal(edge.target(), p.second);
-                }
-            } else {
-                //
-            }
-        }
-};
+    return size_t(2.0 * 2.0 * num_edges * replication * entry_bytes / num_procs);
+}
+
+size_t estimate_neighbors_memory(graph_type &graph) {
+    double replication = double(graph.num_replicas()) / max(graph.num_vertices(), size_t(1));
+    return estimate_neighbors_memory(graph.num_edges(), replication, graph.dc().numprocs());
+}
+
+void clear_neighbors(graph_type::vertex_type &vertex) {
+    vertex.data().clear_neighbors();
+}
+
+template <typename vertex_program_type>
+void run_engine(context_t &ctx, graph_type &graph, bool is_master) {
+    // start engine
+    timer_next("initialize engine");
+    graphlab::omni_engine<metrics::instrumented<vertex_program_type> > engine(ctx.dc, graph, "synchronous", ctx.clopts);
+    engine.signal_all();
+
+#ifdef GRANULA
+    granula::operation processGraph("PowerGraph", "Id.Unique", "ProcessGraph", "Id.Unique");
+    if(is_master) {
+        cout<<processGraph.getOperationInfo("StartTime", processGraph.getEpoch())<<endl;
+    }
+#endif
+
+    // run algorithm
+    timer_next("run algorithm");
+    metrics::begin_run(ctx.dc);
+    global_count_sent = true;
+    engine.start();
+    global_count_sent = false;
+    metrics::end_run(ctx.dc);
+
+    // Vertices that were not signaled in the last superstep still hold
+    // their neighbor lists, on the masters and on the mirrors
+    graph.transform_vertices(clear_neighbors);
+
+#ifdef GRANULA
+    if(is_master) {
+        cout<<processGraph.getOperationInfo("EndTime", processGraph.getEpoch())<<endl;
+    }
+#endif
+}
+
+
+template <bool directed>
+void run_rounds(context_t &ctx, graph_type &graph, bool is_master, size_t num_rounds) {
+    // start engine
+    timer_next("initialize engine");
+    graphlab::omni_engine<metrics::instrumented<partitioned_triangle_count<directed> > > engine(ctx.dc, graph, "synchronous", ctx.clopts);
+    global_partial.assign(graph, make_pair(0, 0));
+    global_num_rounds = num_rounds;
+
+#ifdef GRANULA
+    granula::operation processGraph("PowerGraph", "Id.Unique", "ProcessGraph", "Id.Unique");
+    if(is_master) {
+        cout<<processGraph.getOperationInfo("StartTime", processGraph.getEpoch())<<endl;
+    }
+#endif
+
+    // run algorithm
+    timer_next("run algorithm");
+
+    // Only report the neighbor lists of the largest round, since those
+    // of the previous round are freed before the next one starts.
+    size_t peak_bytes = 0;
 
+    for (global_round = 0; global_round < num_rounds; global_round++) {
+        scoped_timer round_timer("round " + to_string(global_round + 1));
 
+        engine.signal_all();
+        metrics::begin_run(ctx.dc);
+        global_count_sent = true;
+        engine.start();
+        global_count_sent = false;
+        metrics::end_run(ctx.dc);
+        graph.transform_vertices(clear_neighbors);
 
+        peak_bytes = max(peak_bytes, size_t(global_neighbors_bytes));
+        global_neighbors_bytes = 0;
+    }
+
+    global_neighbors_bytes = peak_bytes;
+
+    graph.transform_vertices(finish_rounds);
+    global_partial.clear();
+
+#ifdef GRANULA
+    if(is_master) {
+        cout<<processGraph.getOperationInfo("EndTime", processGraph.getEpoch())<<endl;
+    }
+#endif
+}
 
-void run(context_t& ctx, bool directed, string job_id) {
+
+void run(context_t& ctx, bool directed, bool forward, size_t hub_threshold, size_t memory_budget, size_t rounds,
+         bool compress, size_t sample_size, string job_id) {
     bool is_master = ctx.dc.procid() == 0;
-    timer_start(is_master);
+    timer_start();
 
 #ifdef GRANULA
     granula::startMonitorProcess(getpid());
@@ -191,6 +1320,29 @@ void run(context_t& ctx, bool directed, string job_id) {
 
     // process parmaeters
     global_directed = directed;
+    global_sample_size = sample_size;
+
+    // The lists of the approximate variant are short, and are intersected
+    // without decoding or hub indices
+    global_compress = compress && sample_size == 0;
+
+    // check memory budget. If the neighbor lists do not fit in what is left
+    // after loading the graph, count the triangles in multiple rounds.
+    size_t memory_estimate = memory::estimate(ctx,
+            sizeof(vertex_data_type) + sizeof(double) + sizeof(partitioned_triangle_count<true>) + sizeof(gather_type) + sizeof(msg_type), 0);
+
+    if (memory::exceeds_budget(ctx, "lcc without neighbor lists", memory_estimate)) {
+        memory::abort_over_budget(ctx);
+    }
+
+    size_t neighbors_estimate = estimate_neighbors_memory(ctx.num_edges,
+            memory::replication(ctx), ctx.dc.numprocs());
+
+    if (sample_size > 0) {
+        memory_budget = 0;
+    } else if (memory_budget == 0 && memory::exceeds_budget(ctx, "lcc", memory_estimate + neighbors_estimate)) {
+        memory_budget = max((memory::budget(ctx) - memory_estimate) / (1024 * 1024), size_t(1));
+    }
 
     // load graph
     timer_next("load graph");
@@ -204,27 +1356,63 @@ void run(context_t& ctx, bool directed, string job_id) {
     }
 #endif
 
-    // start engine
-    timer_next("initialize engine");
-    graphlab::omni_engine<triangle_count> engine(ctx.dc, graph, "synchronous", ctx.clopts);
-    engine.signal_all();
+    global_neighbors_bytes = 0;
+    global_sent_bytes = 0;
+    global_sent_plain_bytes = 0;
+    if (sample_size > 0) {
+        global_hub_threshold = numeric_limits<size_t>::max();
+    } else {
+        global_hub_threshold = hub_threshold > 0 ? hub_threshold : pick_hub_threshold(graph);
+    }
 
-#ifdef GRANULA
-    granula::operation processGraph("PowerGraph", "Id.Unique", "ProcessGraph", "Id.Unique");
-    if(is_master) {
-        cout<<processGraph.getOperationInfo("StartTime", processGraph.getEpoch())<<endl;
+    global_clustering_coef.assign(graph, 0.0);
+    size_t num_rounds = 1;
+
+    if (rounds > 0 && sample_size == 0) {
+        num_rounds = rounds;
+    } else if (memory_budget > 0) {
+        size_t estimate = estimate_neighbors_memory(graph);
+        size_t budget = memory_budget * 1024 * 1024;
+        num_rounds = (estimate + budget - 1) / budget;
+
+        if (is_master) {
+            cerr << "Neighbor lists: estimated " << estimate / (1024 * 1024) << " MB per rank, "
+                 << "budget " << memory_budget << " MB, " << num_rounds << " round(s)" << endl;
+        }
     }
-#endif
 
-    // run algorithm
-    timer_next("run algorithm");
-    engine.start();
+    if (is_master && forward && num_rounds > 1 && sample_size == 0) {
+        cerr << "Warning: counting in rounds does not support the forward variant, "
+             << "ignoring --lcc-forward" << endl;
+    }
 
-#ifdef GRANULA
-    if(is_master) {
-        cout<<processGraph.getOperationInfo("EndTime", processGraph.getEpoch())<<endl;
+    if (sample_size > 0) {
+        global_estimates.assign(graph, estimate());
+
+        if (directed) {
+            run_engine<sampled_triangle_count<true> >(ctx, graph, is_master);
+        } else {
+            run_engine<sampled_triangle_count<false> >(ctx, graph, is_master);
+        }
+    } else if (num_rounds > 1) {
+        if (directed) {
+            run_rounds<true>(ctx, graph, is_master, num_rounds);
+        } else {
+            run_rounds<false>(ctx, graph, is_master, num_rounds);
+        }
+    } else if (forward) {
+        if (directed) {
+            run_engine<forward_triangle_count<true> >(ctx, graph, is_master);
+        } else {
+            run_engine<forward_triangle_count<false> >(ctx, graph, is_master);
+        }
+    } else {
+        if (directed) {
+            run_engine<triangle_count<true> >(ctx, graph, is_master);
+        } else {
+            run_engine<triangle_count<false> >(ctx, graph, is_master);
+        }
     }
-#endif
 
 #ifdef GRANULA
     granula::operation offloadGraph("PowerGraph", "Id.Unique", "OffloadGraph", "Id.Unique");
@@ -234,17 +1422,79 @@ void run(context_t& ctx, bool directed, string job_id) {
 #endif
 
     // print output
-    if (ctx.output_enabled) {
+    if (ctx.output_enabled && sample_size > 0) {
+        timer_next("print output");
+
+        vector<pair<graphlab::vertex_id_type, estimate> > data;
+        collect_vertex_column(graph, global_estimates, data, is_master);
+
+        for (size_t i = 0; i < data.size(); i++) {
+            const estimate &e = data[i].second;
+            (*ctx.output_stream) << data[i].first << " " << e.value << " " << e.low << " " << e.high << endl;
+        }
+    } else if (ctx.output_enabled) {
         timer_next("print output");
-        vector<pair<graphlab::vertex_id_type, vertex_data_type> > data;
-        collect_vertex_data(graph, data, is_master);
+
+        vector<pair<graphlab::vertex_id_type, double> > data;
+        collect_vertex_column(graph, global_clustering_coef, data, is_master);
 
         for (size_t i = 0; i < data.size(); i++) {
-            (*ctx.output_stream) << data[i].first << " " << data[i].second.clustering_coef << endl;
+            (*ctx.output_stream) << data[i].first << " " << data[i].second << endl;
         }
     }
 
-    timer_end();
+    timer_end(ctx.dc);
+    metrics::report(ctx.dc, "lcc");
+
+    size_t neighbors_bytes = global_neighbors_bytes;
+    ctx.dc.all_reduce(neighbors_bytes);
+
+    intersect_stats stats = intersect_stats();
+    for (size_t i = 0; i < global_stats.size(); i++) {
+        stats.list_nsec += global_stats[i]->list_nsec;
+        stats.list_calls += global_stats[i]->list_calls;
+        stats.hub_nsec += global_stats[i]->hub_nsec;
+        stats.hub_calls += global_stats[i]->hub_calls;
+        *global_stats[i] = intersect_stats();
+    }
+
+    ctx.dc.all_reduce(stats.list_nsec);
+    ctx.dc.all_reduce(stats.list_calls);
+    ctx.dc.all_reduce(stats.hub_nsec);
+    ctx.dc.all_reduce(stats.hub_calls);
+
+    sample_summary summary;
+
+    if (sample_size > 0) {
+        summary = graph.map_reduce_vertices<sample_summary>(summarize_sample);
+        global_estimates.clear();
+    }
+
+    vector<pair<size_t, size_t> > sent(ctx.dc.numprocs());
+    sent[ctx.dc.procid()] = make_pair(size_t(global_sent_bytes), size_t(global_sent_plain_bytes));
+    ctx.dc.all_gather(sent);
+
+    if (is_master) {
+        for (size_t i = 0; i < sent.size(); i++) {
+            cerr << "Neighbor lists sent by rank " << i << ": " << sent[i].first << " bytes ("
+                 << sent[i].second << " bytes uncompressed)" << endl;
+        }
+
+        cerr << "Neighbor lists: " << neighbors_bytes << " bytes ("
+             << double(neighbors_bytes) / graph.num_vertices() << " bytes/vertex)" << endl;
+        cerr << "Hub threshold: " << global_hub_threshold << " edges" << endl;
+
+        if (sample_size > 0) {
+            cerr << "Sampled neighbor lists: " << summary.vertices << " of " << graph.num_vertices()
+                 << " vertices with more than " << sample_size << " edges, mean interval width "
+                 << (summary.vertices > 0 ? summary.width / summary.vertices : 0.0) << endl;
+        }
+
+        cerr << "Intersections (thread time summed over all ranks, estimated from 1 in "
+             << STATS_SAMPLE_INTERVAL << " calls):" << endl;
+        cerr << " - list: " << stats.list_calls << " calls, " << stats.list_nsec / 1e9 << " sec" << endl;
+        cerr << " - hub: " << stats.hub_calls << " calls, " << stats.hub_nsec / 1e9 << " sec" << endl;
+    }
 
 #ifdef GRANULA
     if(is_master) {
@@ -17,6 +17,7 @@
 #include <fstream>
 
 #include "algorithms.hpp"
+#include "placement.hpp"
 
 // This is very ugly, but it greatly increases compilation time.
 // Compiling all the templates in graphlab.hpp is very heavy,
@@ -28,6 +29,7 @@
 #include "wcc.cpp"
 #include "lcc.cpp"
 #include "sssp.cpp"
+#include "shm.cpp"
 
 
 using namespace std;
@@ -51,11 +53,49 @@ int main(int argc, char **argv) {
     clopts.attach_option("damping-factor", pr_damping_factor,
             "Damping factor to use (PageRank only)");
 
+    double pr_tolerance = 0;
+    clopts.attach_option("pr-tolerance", pr_tolerance,
+            "Stop before max-iterations once the ranks change less than this in total in an iteration, 0 runs all iterations (PageRank only)");
+
     // BFS specific options
     graphlab::vertex_id_type traverse_source_vertex = 0;
     clopts.attach_option("source-vertex", traverse_source_vertex,
             "Source vertex ot use (BFS and SSSP only)");
 
+    // CDLP specific options
+    bool cdlp_incremental = false;
+    clopts.attach_option("cdlp-incremental", cdlp_incremental,
+            "Keep label histograms across iterations and only apply changes (CDLP only)");
+
+    // LCC specific options
+    bool lcc_forward = false;
+    clopts.attach_option("lcc-forward", lcc_forward,
+            "Only store neighbors of higher degree and count each triangle once (LCC only)");
+
+    size_t lcc_hub_threshold = 0;
+    clopts.attach_option("lcc-hub-threshold", lcc_hub_threshold,
+            "Minimum number of edges of a vertex for which its neighbor list gets a lookup index, 0 picks it from the degree distribution (LCC only)");
+
+    size_t lcc_memory_budget = 0;
+    clopts.attach_option("lcc-memory-budget", lcc_memory_budget,
+            "Memory in MB per process for neighbor lists, counts triangles in multiple rounds if needed, which overrides --lcc-forward (LCC only)");
+
+    size_t lcc_rounds = 0;
+    clopts.attach_option("lcc-rounds", lcc_rounds,
+            "Number of rounds to count triangles in, 0 picks it from lcc-memory-budget (LCC only)");
+
+    bool lcc_compress = false;
+    clopts.attach_option("lcc-compress", lcc_compress,
+            "Store and send neighbor lists delta and varint encoded (LCC only)");
+
+    bool lcc_approximate = false;
+    clopts.attach_option("lcc-approximate", lcc_approximate,
+            "Estimate the coefficients of vertices with many edges from a sample of their neighbors, and print a 95% confidence interval after every value (LCC only)");
+
+    size_t lcc_samples = 256;
+    clopts.attach_option("lcc-samples", lcc_samples,
+            "Expected number of neighbors sampled per vertex by lcc-approximate, vertices with at most this many edges are exact (LCC only)");
+
     // General options
     string vertex_file;
     clopts.attach_option("vertices-file", vertex_file,
@@ -89,6 +129,70 @@ int main(int argc, char **argv) {
     clopts.attach_option("output-console", output_console,
             "Write output to stdout");
 
+    size_t num_vertices = 0;
+    clopts.attach_option("num-vertices", num_vertices,
+            "Number of vertices of the graph, used to estimate memory usage before loading");
+
+    size_t num_edges = 0;
+    clopts.attach_option("num-edges", num_edges,
+            "Number of edges of the graph, used to estimate memory usage before loading");
+
+    size_t memory_budget = 0;
+    clopts.attach_option("memory-budget", memory_budget,
+            "Memory in MB per process, stops before loading or picks a variant using less memory if the estimate exceeds it");
+
+    bool superstep_metrics = false;
+    clopts.attach_option("superstep-metrics", superstep_metrics,
+            "Report the time of every phase, active vertices and messages for every superstep");
+
+    bool perf_counters = false;
+    clopts.attach_option("perf-counters", perf_counters,
+            "Report hardware performance counters for every phase");
+
+    bool perf_counters_supersteps = false;
+    clopts.attach_option("perf-counters-supersteps", perf_counters_supersteps,
+            "Also report hardware performance counters for every superstep (requires perf-counters, enables superstep-metrics)");
+
+    bool compress_payloads = false;
+    clopts.attach_option("compress-payloads", compress_payloads,
+            "Compress large label histograms and neighbor lists exchanged between processes (CDLP and LCC only)");
+
+    size_t compress_threshold = 512;
+    clopts.attach_option("compress-threshold", compress_threshold,
+            "Minimum size in bytes of a histogram or neighbor list to compress it");
+
+    bool delta_sync = false;
+    clopts.attach_option("delta-sync", delta_sync,
+            "Only send vertex data to mirrors if apply changed it, otherwise a flag (CDLP only)");
+
+    string checkpoint_dir;
+    clopts.attach_option("checkpoint-dir", checkpoint_dir,
+            "Directory (e.g., on node-local storage) for checkpoints of the vertex data (PR and CDLP only)");
+
+    size_t checkpoint_interval = 10;
+    clopts.attach_option("checkpoint-interval", checkpoint_interval,
+            "Number of supersteps between two checkpoints");
+
+    string prior_result;
+    clopts.attach_option("prior-result", prior_result,
+            "Output of a previous run to start from, on the graph before the edge updates (BFS, WCC and PR only)");
+
+    string edge_updates;
+    clopts.attach_option("edge-updates", edge_updates,
+            "Edges inserted (\"+ source target\") and deleted (\"- source target\") since the prior result");
+
+    string backend = "engine";
+    clopts.attach_option("backend", backend,
+            "Run on the distributed engine (engine) or, with a single process, on a graph in shared memory (shm)");
+
+    size_t shm_grain = 4096;
+    clopts.attach_option("shm-grain", shm_grain,
+            "Edges per task of the shared-memory backend, vertices with more edges are split over threads, 0 disables splitting");
+
+    bool resume = false;
+    clopts.attach_option("resume", resume,
+            "Continue from the last checkpoint in the checkpoint directory (PR and CDLP only)");
+
 
     if (!clopts.parse(argc, argv)) {
         dc.cerr() << "Error in parsing command line arguments." << endl;
@@ -100,6 +204,19 @@ int main(int argc, char **argv) {
         return EXIT_FAILURE;
     }
 
+    perf::configure(perf_counters, perf_counters_supersteps);
+
+#ifdef GRANULA
+    // The supersteps of the Granula archive come from the superstep metrics
+    superstep_metrics = true;
+#endif
+
+    metrics::configure(superstep_metrics || perf_counters_supersteps);
+    compression::configure(compress_payloads, compress_threshold);
+    mirror::configure(delta_sync);
+    placement::configure(clopts, argc, argv);
+    placement::report(dc, clopts.get_ncpus());
+
     bool output_enabled = false;
     ostream *output_stream = NULL;
     ofstream *file_stream = NULL;
@@ -128,19 +245,109 @@ int main(int argc, char **argv) {
         dc : dc,
         clopts : clopts,
         output_enabled : output_enabled,
-        output_stream : output_stream
+        output_stream : output_stream,
+        num_vertices : num_vertices,
+        num_edges : num_edges,
+        memory_budget : memory_budget,
+        checkpoint_dir : checkpoint_dir,
+        checkpoint_interval : checkpoint_interval,
+        resume : resume,
+        prior_result : prior_result,
+        edge_updates : edge_updates
     };
 
-    if (algorithm == "bfs") {
+    if (backend == "shm" && dc.numprocs() > 1) {
+        if (dc.procid() == 0) {
+            cerr << "The shared-memory backend needs a single process, using the engine" << endl;
+        }
+
+        backend = "engine";
+    }
+
+    bool shm_algorithm = algorithm == "bfs" || algorithm == "wcc" || algorithm == "pr"
+                      || algorithm == "cdlp" || algorithm == "lcc" || algorithm == "sssp";
+
+    if (!prior_result.empty() && algorithm != "bfs" && algorithm != "wcc" && algorithm != "pr") {
+        dc.cerr() << "A prior result can only be used by BFS, WCC and PR" << endl;
+        return EXIT_FAILURE;
+    } else if (prior_result.empty() && !edge_updates.empty()) {
+        dc.cerr() << "Edge updates need a prior result" << endl;
+        return EXIT_FAILURE;
+    } else if (!prior_result.empty() && algorithm == "pr" && pr_tolerance <= 0) {
+        // A warm start does not reproduce the ranks after a fixed number of
+        // iterations, it only converges to the same fixed point
+        dc.cerr() << "A prior result for PR needs --pr-tolerance > 0" << endl;
+        return EXIT_FAILURE;
+    }
+
+    if (backend == "shm" && !prior_result.empty()) {
+        if (dc.procid() == 0) {
+            cerr << "The shared-memory backend does not start from a prior result, using the engine" << endl;
+        }
+
+        backend = "engine";
+    }
+
+    if (lcc_approximate && lcc_samples < 2) {
+        dc.cerr() << "Approximate LCC needs at least 2 samples per vertex" << endl;
+        return EXIT_FAILURE;
+    }
+
+    if (backend == "shm" && algorithm == "lcc" && lcc_approximate) {
+        if (dc.procid() == 0) {
+            cerr << "The shared-memory backend only computes exact LCC, using the engine" << endl;
+        }
+
+        backend = "engine";
+    }
+
+    if (backend == "shm" && algorithm == "pr" && pr_tolerance > 0) {
+        if (dc.procid() == 0) {
+            cerr << "The shared-memory backend always runs all PR iterations, using the engine" << endl;
+        }
+
+        backend = "engine";
+    }
+
+    if (backend == "shm" && (algorithm == "pr" || algorithm == "cdlp") && (!checkpoint_dir.empty() || resume)) {
+        if (dc.procid() == 0) {
+            cerr << "The shared-memory backend does not write or resume checkpoints, using the engine" << endl;
+        }
+
+        backend = "engine";
+    }
+
+    // The remaining options do not change the output, so they are only ignored
+    if (backend == "shm" && dc.procid() == 0) {
+        if (delta_sync || compress_payloads) {
+            cerr << "The shared-memory backend does not exchange data between processes, "
+                 << "ignoring --delta-sync and --compress-payloads" << endl;
+        }
+
+        if (memory_budget > 0) {
+            cerr << "The shared-memory backend does not check the memory budget" << endl;
+        }
+    }
+
+    if (backend != "engine" && backend != "shm") {
+        dc.cerr() << "Unknown backend specified: " << backend << endl;
+        return EXIT_FAILURE;
+    } else if (backend == "shm" && shm_algorithm) {
+        if (!graphalytics::shm::run(ctx, algorithm, directed, traverse_source_vertex, pr_damping_factor, max_iter, shm_grain, job_id)) {
+            dc.cerr() << "error occured while loading the graph" << endl;
+            return EXIT_FAILURE;
+        }
+    } else if (algorithm == "bfs") {
         graphalytics::bfs::run(ctx, directed, traverse_source_vertex, job_id);
     } else if (algorithm == "wcc") {
         graphalytics::wcc::run(ctx, job_id);
     } else if (algorithm == "pr") {
-        graphalytics::pr::run(ctx, directed, pr_damping_factor, max_iter, job_id);
+        graphalytics::pr::run(ctx, directed, pr_damping_factor, max_iter, pr_tolerance, job_id);
     } else if (algorithm == "cdlp") {
-        graphalytics::cdlp::run(ctx, max_iter, job_id);
+        graphalytics::cdlp::run(ctx, max_iter, cdlp_incremental, job_id);
     } else if (algorithm == "lcc") {
-        graphalytics::lcc::run(ctx, directed, job_id);
+        graphalytics::lcc::run(ctx, directed, lcc_forward, lcc_hub_threshold, lcc_memory_budget, lcc_rounds, lcc_compress,
+                                lcc_approximate ? lcc_samples : 0, job_id);
     } else if (algorithm == "sssp") {
         graphalytics::sssp::run(ctx, directed, traverse_source_vertex, job_id);
     } else {
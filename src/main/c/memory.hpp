@@ -0,0 +1,137 @@
+/*
+ * Copyright 2015 Delft University of Technology
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef MEMORY_HPP
+#define MEMORY_HPP
+
+#include <graphlab.hpp>
+#include <graphlab/util/memory_info.hpp>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <iostream>
+#include <string>
+
+#include "algorithms.hpp"
+
+#ifdef GRANULA
+#include "granula.hpp"
+#endif
+
+// Memory usage of this process, and a rough estimate of the memory an
+// algorithm needs per rank, computed from the size of the graph before it
+// is loaded. The estimate is compared to the budget given by --memory-budget.
+namespace memory {
+
+struct usage : public graphlab::IS_POD_TYPE {
+    size_t rss;
+    size_t peak_rss;
+    size_t heap;        // tcmalloc heap size, 0 if tcmalloc is not used
+    size_t allocated;   // bytes allocated by the application through tcmalloc
+
+    usage() : rss(0), peak_rss(0), heap(0), allocated(0) {
+        //
+    }
+};
+
+static size_t read_status_kb(const char *line, const char *key) {
+    size_t n = strlen(key);
+    return strncmp(line, key, n) == 0 ? strtoull(line + n, NULL, 10) : 0;
+}
+
+static usage current() {
+    usage u;
+    FILE *f = fopen("/proc/self/status", "r");
+
+    if (f != NULL) {
+        char line[256];
+
+        while (fgets(line, sizeof(line), f) != NULL) {
+            u.rss = std::max(u.rss, read_status_kb(line, "VmRSS:") * 1024);
+            u.peak_rss = std::max(u.peak_rss, read_status_kb(line, "VmHWM:") * 1024);
+        }
+
+        fclose(f);
+    }
+
+    if (graphlab::memory_info::available()) {
+        u.heap = graphlab::memory_info::heap_bytes();
+        u.allocated = graphlab::memory_info::allocated_bytes();
+    }
+
+    return u;
+}
+
+// Bytes per edge and per vertex replica used by PowerGraph itself, including
+// the buffers used while loading the graph.
+const size_t EDGE_BYTES = 64;
+const size_t VERTEX_BYTES = 128;
+
+// The replication factor is only known after loading, so assume that every
+// vertex has a replica on this many ranks (or all ranks, if there are fewer).
+const size_t ASSUMED_REPLICATION = 4;
+
+static double replication(const context_t &ctx) {
+    return double(std::min(ctx.dc.numprocs(), ASSUMED_REPLICATION));
+}
+
+// Estimates the memory needed per rank, given the size of the data stored
+// for every vertex replica and the additional bytes needed for every edge.
+// Returns 0 if the size of the graph is unknown.
+static size_t estimate(const context_t &ctx, size_t vertex_bytes, size_t edge_bytes) {
+    double vertices = ctx.num_vertices * replication(ctx) * (VERTEX_BYTES + vertex_bytes);
+    double edges = ctx.num_edges * double(EDGE_BYTES + edge_bytes);
+
+    return size_t((vertices + edges) / ctx.dc.numprocs());
+}
+
+static size_t budget(const context_t &ctx) {
+    return ctx.memory_budget * 1024 * 1024;
+}
+
+// Reports the estimate and returns whether it exceeds the budget
+static bool exceeds_budget(const context_t &ctx, const std::string &what, size_t bytes) {
+    if (ctx.memory_budget == 0 || ctx.num_edges == 0) {
+        return false;
+    }
+
+    if (ctx.dc.procid() == 0) {
+        std::cerr << "Memory estimate (" << what << "): " << bytes / (1024 * 1024) << " MB per rank, "
+                  << "budget " << ctx.memory_budget << " MB" << std::endl;
+    }
+
+    return bytes > budget(ctx);
+}
+
+// Stops the job on all ranks. Every rank computes the same estimate, so all
+// of them call this.
+static void abort_over_budget(const context_t &ctx) {
+    if (ctx.dc.procid() == 0) {
+        std::cerr << "Memory estimate exceeds the budget of " << ctx.memory_budget
+                  << " MB per rank, aborting before loading the graph" << std::endl;
+    }
+
+#ifdef GRANULA
+    granula::stopMonitorProcess(getpid());
+#endif
+
+    graphlab::mpi_tools::finalize();
+    exit(EXIT_FAILURE);
+}
+
+}
+
+#endif
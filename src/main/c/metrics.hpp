@@ -0,0 +1,505 @@
+/*
+ * Copyright 2015 Delft University of Technology
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef METRICS_HPP
+#define METRICS_HPP
+
+#include <graphlab.hpp>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "compression.hpp"
+#include "perf.hpp"
+
+#ifdef GRANULA
+#include "granula.hpp"
+#endif
+
+// Per-superstep metrics of the synchronous engine. Vertex programs are wrapped
+// in instrumented<P>, which records on every rank when each phase of a
+// superstep starts and counts the active vertices and the messages sent.
+// After the algorithm has finished, the master writes one JSON record per
+// superstep to stderr. The metrics are only collected if enabled with
+// configure(), otherwise the wrapper forwards every call directly.
+//
+// Usage:
+//
+//   graphlab::omni_engine<metrics::instrumented<program> > engine(...);
+//   metrics::begin_run(ctx.dc);
+//   engine.start();
+//   metrics::end_run(ctx.dc);
+//   ...
+//   metrics::report(ctx.dc, "name");
+//
+// Multiple runs (engine starts) between two reports are numbered consecutively.
+namespace metrics {
+
+enum phase_type { INIT, GATHER, APPLY, SCATTER, NUM_PHASES };
+
+// One superstep as seen by one rank. Phase times are the times of the first
+// call of that phase on this rank, in seconds since the first begin_run.
+struct superstep_record : public graphlab::IS_POD_TYPE {
+    bool active;
+    double phase_start[NUM_PHASES];
+    double end;
+    size_t bytes_sent;
+    size_t bytes_received;
+    size_t active_vertices;
+    size_t messages;
+
+    // Hardware counters, only sampled if enabled for supersteps
+    perf::sample counters;
+
+    // Payloads serialized and compressed by this rank
+    compression::totals compression;
+};
+
+// Counters of one thread, indexed by superstep. They are only summed when
+// the metrics are reported.
+struct thread_counters {
+    std::vector<size_t> active_vertices;
+    std::vector<size_t> messages;
+
+    static void increment(std::vector<size_t> &counts, size_t step) {
+        if (counts.size() <= step) {
+            counts.resize(step + 1);
+        }
+
+        counts[step]++;
+    }
+};
+
+static bool global_enabled;
+static std::mutex global_mutex;
+static std::vector<thread_counters*> global_counters;
+static std::vector<superstep_record> global_records;
+static std::atomic<long> global_last_mark(-1);
+static size_t global_offset;
+static bool global_started;
+static std::chrono::steady_clock::time_point global_base;
+static int64_t global_base_epoch_ms;
+static graphlab::distributed_control *global_dc;
+
+inline void configure(bool enabled) {
+    global_enabled = enabled;
+}
+
+static thread_counters& local_counters() {
+    static thread_local thread_counters *counters = NULL;
+
+    if (counters == NULL) {
+        counters = new thread_counters();
+        std::lock_guard<std::mutex> guard(global_mutex);
+        global_counters.push_back(counters);
+    }
+
+    return *counters;
+}
+
+static double now() {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - global_base).count();
+}
+
+// Records the start of the given phase if this is its first call in the
+// superstep. Returns the index of the superstep.
+template <typename C>
+size_t begin_phase(C &context, phase_type phase) {
+    size_t step = global_offset + context.iteration();
+    long mark = long(step) * NUM_PHASES + phase;
+
+    if (mark > global_last_mark.load(std::memory_order_relaxed)) {
+        std::lock_guard<std::mutex> guard(global_mutex);
+
+        if (mark > global_last_mark.load(std::memory_order_relaxed)) {
+            if (global_records.size() <= step) {
+                global_records.resize(step + 1, superstep_record());
+            }
+
+            superstep_record &r = global_records[step];
+
+            if (!r.active) {
+                r.active = true;
+                r.bytes_sent = global_dc->bytes_sent();
+                r.bytes_received = global_dc->bytes_received();
+
+                if (perf::supersteps_enabled()) {
+                    r.counters = perf::read();
+                }
+
+                r.compression = compression::read();
+            }
+
+            r.phase_start[phase] = now();
+            global_last_mark.store(mark, std::memory_order_relaxed);
+        }
+    }
+
+    return step;
+}
+
+// Forwards everything to the engine's context, but counts the messages sent.
+template <typename C>
+class counting_context : public C {
+    public:
+        typedef typename C::vertex_type vertex_type;
+        typedef typename C::vertex_id_type vertex_id_type;
+        typedef typename C::message_type message_type;
+        typedef typename C::gather_type gather_type;
+
+        counting_context(C &context, size_t step) :
+                context(context), counters(local_counters()), step(step) {
+            //
+        }
+
+        size_t num_vertices() const { return context.num_vertices(); }
+        size_t num_edges() const { return context.num_edges(); }
+        size_t procid() const { return context.procid(); }
+        size_t num_procs() const { return context.num_procs(); }
+        std::ostream& cout() const { return context.cout(); }
+        std::ostream& cerr() const { return context.cerr(); }
+        float elapsed_seconds() const { return context.elapsed_seconds(); }
+        int iteration() const { return context.iteration(); }
+        void stop() { context.stop(); }
+
+        void signal(const vertex_type& vertex, const message_type& message = message_type()) {
+            thread_counters::increment(counters.messages, step);
+            context.signal(vertex, message);
+        }
+
+        void signal_vid(vertex_id_type gvid, const message_type& message = message_type()) {
+            thread_counters::increment(counters.messages, step);
+            context.signal_vid(gvid, message);
+        }
+
+        void post_delta(const vertex_type& vertex, const gather_type& delta) {
+            context.post_delta(vertex, delta);
+        }
+
+        void clear_gather_cache(const vertex_type& vertex) {
+            context.clear_gather_cache(vertex);
+        }
+
+    private:
+        C &context;
+        thread_counters &counters;
+        size_t step;
+};
+
+template <typename P>
+class instrumented : public P {
+    public:
+        typedef typename P::icontext_type icontext_type;
+        typedef typename P::vertex_type vertex_type;
+        typedef typename P::edge_type edge_type;
+        typedef typename P::gather_type gather_type;
+        typedef typename P::message_type message_type;
+        typedef typename P::edge_dir_type edge_dir_type;
+
+        void init(icontext_type& context, const vertex_type& vertex, const message_type& msg) {
+            if (!global_enabled) {
+                P::init(context, vertex, msg);
+                return;
+            }
+
+            size_t step = begin_phase(context, INIT);
+            thread_counters::increment(local_counters().active_vertices, step);
+            P::init(context, vertex, msg);
+        }
+
+        edge_dir_type gather_edges(icontext_type& context, const vertex_type& vertex) const {
+            if (global_enabled) begin_phase(context, GATHER);
+            return P::gather_edges(context, vertex);
+        }
+
+        void apply(icontext_type& context, vertex_type& vertex, const gather_type& total) {
+            if (!global_enabled) {
+                P::apply(context, vertex, total);
+                return;
+            }
+
+            counting_context<icontext_type> c(context, begin_phase(context, APPLY));
+            P::apply(c, vertex, total);
+        }
+
+        edge_dir_type scatter_edges(icontext_type& context, const vertex_type& vertex) const {
+            if (global_enabled) begin_phase(context, SCATTER);
+            return P::scatter_edges(context, vertex);
+        }
+
+        void scatter(icontext_type& context, const vertex_type& vertex, edge_type& edge) const {
+            if (!global_enabled) {
+                P::scatter(context, vertex, edge);
+                return;
+            }
+
+            counting_context<icontext_type> c(context, global_offset + context.iteration());
+            P::scatter(c, vertex, edge);
+        }
+};
+
+static void begin_run(graphlab::distributed_control &dc) {
+    if (!global_enabled) {
+        return;
+    }
+
+    if (!global_started) {
+        global_started = true;
+        global_base = std::chrono::steady_clock::now();
+        global_base_epoch_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::system_clock::now().time_since_epoch()).count();
+    }
+
+    global_dc = &dc;
+}
+
+// Closes the last superstep of the run. The number of supersteps is agreed
+// on by all ranks, since ranks without active vertices do not see all of them.
+static void end_run(graphlab::distributed_control &dc) {
+    if (!global_enabled) {
+        return;
+    }
+
+    std::vector<size_t> steps(dc.numprocs());
+    steps[dc.procid()] = global_records.size();
+    dc.all_gather(steps);
+
+    size_t num_steps = global_offset;
+    for (size_t i = 0; i < steps.size(); i++) {
+        num_steps = std::max(num_steps, steps[i]);
+    }
+
+    double end = now();
+    size_t bytes_sent = dc.bytes_sent();
+    size_t bytes_received = dc.bytes_received();
+    perf::sample counters = perf::supersteps_enabled() ? perf::read() : perf::sample();
+    compression::totals compressed = compression::read();
+
+    global_records.resize(num_steps, superstep_record());
+
+    // Every superstep ends where the next active one on this rank starts
+    for (size_t i = num_steps; i-- > global_offset;) {
+        superstep_record &r = global_records[i];
+
+        if (!r.active) {
+            continue;
+        }
+
+        r.end = end;
+        r.bytes_sent = bytes_sent - r.bytes_sent;
+        r.bytes_received = bytes_received - r.bytes_received;
+
+        perf::sample start = r.counters;
+        r.counters = counters;
+        r.counters -= start;
+        counters = start;
+
+        compression::totals compression_start = r.compression;
+        r.compression = compressed;
+        r.compression -= compression_start;
+        compressed = compression_start;
+
+        // A phase without calls ends immediately
+        for (int p = NUM_PHASES - 1; p >= 0; p--) {
+            if (r.phase_start[p] == 0) {
+                r.phase_start[p] = p + 1 < NUM_PHASES ? r.phase_start[p + 1] : r.end;
+            }
+        }
+
+        end = r.phase_start[INIT];
+        bytes_sent -= r.bytes_sent;
+        bytes_received -= r.bytes_received;
+    }
+
+    global_offset = num_steps;
+    global_last_mark = long(num_steps) * NUM_PHASES - 1;
+}
+
+template <typename F>
+void write_array(std::ostream &out, const char *name,
+                 const std::vector<std::vector<superstep_record> > &records, size_t step, F f) {
+    out << ",\"" << name << "\":[";
+
+    for (size_t i = 0; i < records.size(); i++) {
+        const superstep_record &r = records[i][step];
+        out << (i > 0 ? "," : "") << (r.active ? f(r) : 0);
+    }
+
+    out << "]";
+}
+
+struct phase_time {
+    int phase;
+
+    phase_time(int phase) : phase(phase) {
+        //
+    }
+
+    double operator()(const superstep_record &r) const {
+        double end = phase + 1 < NUM_PHASES ? r.phase_start[phase + 1] : r.end;
+        return end - r.phase_start[phase];
+    }
+};
+
+struct counter_value {
+    int counter;
+
+    counter_value(int counter) : counter(counter) {
+        //
+    }
+
+    uint64_t operator()(const superstep_record &r) const {
+        return r.counters.values[counter];
+    }
+};
+
+static uint64_t compress_raw_bytes(const superstep_record &r) {
+    return r.compression.raw_bytes;
+}
+
+static uint64_t compress_bytes(const superstep_record &r) {
+    return r.compression.encoded_bytes;
+}
+
+static double compress_time(const superstep_record &r) {
+    return r.compression.compress_ns * 1e-9;
+}
+
+static double decompress_time(const superstep_record &r) {
+    return r.compression.decompress_ns * 1e-9;
+}
+
+static double superstep_time(const superstep_record &r) {
+    return r.end - r.phase_start[INIT];
+}
+
+static size_t sent(const superstep_record &r) {
+    return r.bytes_sent;
+}
+
+static size_t received(const superstep_record &r) {
+    return r.bytes_received;
+}
+
+// Collects the records of all ranks and writes them on the master, one JSON
+// object per line. Arrays contain one entry per rank. Resets all metrics.
+static void report(graphlab::distributed_control &dc, const std::string &algorithm) {
+    std::vector<superstep_record> &local = global_records;
+
+    // Without superstep records, only the compression totals are reported
+    if (!global_enabled) {
+        superstep_record r = superstep_record();
+        r.compression = compression::read();
+        local.assign(1, r);
+    }
+
+    for (size_t i = 0; i < global_counters.size(); i++) {
+        thread_counters &c = *global_counters[i];
+
+        for (size_t j = 0; j < c.active_vertices.size() && j < local.size(); j++) {
+            local[j].active_vertices += c.active_vertices[j];
+        }
+
+        for (size_t j = 0; j < c.messages.size() && j < local.size(); j++) {
+            local[j].messages += c.messages[j];
+        }
+
+        c = thread_counters();
+    }
+
+    std::vector<std::vector<superstep_record> > records(dc.numprocs());
+    records[dc.procid()].swap(local);
+    dc.all_gather(records);
+
+    if (dc.procid() == 0) {
+        if (compression::enabled()) {
+            compression::totals total;
+
+            for (size_t i = 0; i < records.size(); i++) {
+                for (size_t step = 0; step < records[i].size(); step++) {
+                    total += records[i][step].compression;
+                }
+            }
+
+            std::cerr << "Compression: " << total.raw_bytes << " bytes serialized as " << total.encoded_bytes
+                      << " bytes (" << total.compressed_arrays << " compressed arrays), "
+                      << total.compress_ns * 1e-9 << " sec compressing, "
+                      << total.decompress_ns * 1e-9 << " sec decompressing" << std::endl;
+        }
+
+        for (size_t step = 0; step < global_offset; step++) {
+            size_t active_vertices = 0;
+            size_t messages = 0;
+
+            for (size_t i = 0; i < records.size(); i++) {
+                active_vertices += records[i][step].active_vertices;
+                messages += records[i][step].messages;
+            }
+
+            std::cerr << "{\"type\":\"superstep\",\"algorithm\":\"" << algorithm << "\""
+                      << ",\"superstep\":" << step
+                      << ",\"active_vertices\":" << active_vertices
+                      << ",\"messages\":" << messages;
+
+            write_array(std::cerr, "time_sec", records, step, superstep_time);
+            write_array(std::cerr, "init_sec", records, step, phase_time(INIT));
+            write_array(std::cerr, "gather_sec", records, step, phase_time(GATHER));
+            write_array(std::cerr, "apply_sec", records, step, phase_time(APPLY));
+            write_array(std::cerr, "scatter_sec", records, step, phase_time(SCATTER));
+            write_array(std::cerr, "bytes_sent", records, step, sent);
+            write_array(std::cerr, "bytes_received", records, step, received);
+
+            if (perf::supersteps_enabled()) {
+                for (int c = 0; c < perf::NUM_COUNTERS; c++) {
+                    write_array(std::cerr, perf::COUNTER_NAMES[c], records, step, counter_value(c));
+                }
+            }
+
+            if (compression::enabled()) {
+                write_array(std::cerr, "compress_raw_bytes", records, step, compress_raw_bytes);
+                write_array(std::cerr, "compress_bytes", records, step, compress_bytes);
+                write_array(std::cerr, "compress_sec", records, step, compress_time);
+                write_array(std::cerr, "decompress_sec", records, step, decompress_time);
+            }
+
+            std::cerr << "}" << std::endl;
+
+#ifdef GRANULA
+            const superstep_record &r = records[0][step];
+
+            if (r.active) {
+                granula::operation superstep("Bsp", "Id.Unique", "Superstep", "Id." + std::to_string(step));
+                int64_t start_ms = global_base_epoch_ms + int64_t(r.phase_start[INIT] * 1000);
+                int64_t end_ms = global_base_epoch_ms + int64_t(r.end * 1000);
+
+                std::cout << superstep.getOperationInfo("StartTime", std::to_string(start_ms)) << std::endl;
+                std::cout << superstep.getOperationInfo("EndTime", std::to_string(end_ms)) << std::endl;
+            }
+#endif
+        }
+    }
+
+    global_records.clear();
+    global_offset = 0;
+    global_last_mark = -1;
+    global_started = false;
+}
+
+}
+
+#endif
@@ -0,0 +1,195 @@
+/*
+ * Copyright 2015 Delft University of Technology
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef MIRROR_HPP
+#define MIRROR_HPP
+
+#include <graphlab.hpp>
+#include <stdint.h>
+#include <atomic>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Delta synchronization of vertex data from masters to mirrors. After every
+// apply, the engine serializes the data of the vertex on its master and sends
+// it to all mirrors, even if apply left it unchanged. In CDLP, a vertex is
+// activated whenever one of its neighbors changes its label, and often keeps
+// its own. (WCC only signals neighbors whose label decreases, so every apply
+// changes the value and it does not use this.) A vertex value of type
+// synced<T> remembers whether the last apply changed it, and while a
+// scope is alive (i.e., while the engine runs), only sends a flag if it did
+// not, so the mirrors keep their copy. Outside a scope, such as when
+// collecting the output, the value is always sent.
+//
+// PowerGraph does not load the data into the mirror, but into a temporary
+// which is then assigned to it. A value loaded without its data is marked as
+// not sent, and assigning it leaves the value of the target unchanged.
+//
+// The vertex program must call update() in every apply:
+//
+//   typedef mirror::synced<label_type> vertex_data_type;
+//   ...
+//   changed = vertex.data().update(new_label);
+//   ...
+//   {
+//       mirror::scope sync;
+//       engine.start();
+//   }
+//   mirror::report(ctx.dc, "name");
+namespace mirror {
+
+static bool global_enabled = false;
+static bool global_active;
+
+// Synchronizations by this rank, and the ones which only sent the flag
+static std::atomic<size_t> global_syncs;
+static std::atomic<size_t> global_skipped;
+static std::atomic<size_t> global_saved_bytes;
+
+inline void configure(bool enabled) {
+    global_enabled = enabled;
+}
+
+// Enables delta synchronization while the engine runs
+class scope {
+    public:
+        scope() {
+            global_active = global_enabled;
+        }
+
+        ~scope() {
+            global_active = false;
+        }
+};
+
+template <typename T>
+class synced {
+    public:
+        synced() : value(), changed(true), sent(true) {
+            //
+        }
+
+        synced(const T &v) : value(v), changed(true), sent(true) {
+            //
+        }
+
+        synced& operator=(const synced &other) {
+            if (other.sent) {
+                value = other.value;
+                changed = other.changed;
+                sent = true;
+            }
+
+            return *this;
+        }
+
+        // Sets the value in apply, returns whether it changed
+        bool update(const T &v) {
+            changed = v != value;
+            value = v;
+            return changed;
+        }
+
+        operator const T&() const {
+            return value;
+        }
+
+        void save(graphlab::oarchive& oarc) const {
+            if (!global_active) {
+                oarc << value;
+                return;
+            }
+
+            oarc << changed;
+            global_syncs++;
+
+            if (changed) {
+                oarc << value;
+            } else {
+                global_skipped++;
+                global_saved_bytes += sizeof(T);
+            }
+        }
+
+        void load(graphlab::iarchive& iarc) {
+            if (!global_active) {
+                iarc >> value;
+                sent = true;
+                return;
+            }
+
+            iarc >> sent;
+
+            if (sent) {
+                iarc >> value;
+            }
+        }
+
+    private:
+        T value;
+
+        // Whether the last apply changed the value, the mirrors hold the
+        // same value otherwise
+        bool changed;
+
+        // Whether the last load received the value, or only the flag
+        bool sent;
+};
+
+struct counts : public graphlab::IS_POD_TYPE {
+    size_t syncs;
+    size_t skipped;
+    size_t saved_bytes;
+};
+
+// Writes the synchronizations skipped by all ranks, and the bytes saved net
+// of the flags, to stderr. Resets the counts.
+static void report(graphlab::distributed_control &dc, const std::string &algorithm) {
+    if (!global_enabled) {
+        return;
+    }
+
+    std::vector<counts> all(dc.numprocs());
+    all[dc.procid()].syncs = global_syncs.exchange(0);
+    all[dc.procid()].skipped = global_skipped.exchange(0);
+    all[dc.procid()].saved_bytes = global_saved_bytes.exchange(0);
+    dc.all_gather(all);
+
+    if (dc.procid() == 0) {
+        counts total = counts();
+
+        for (size_t i = 0; i < all.size(); i++) {
+            total.syncs += all[i].syncs;
+            total.skipped += all[i].skipped;
+            total.saved_bytes += all[i].saved_bytes;
+        }
+
+        // Every synchronization sends one extra byte for the flag
+        int64_t net_bytes = int64_t(total.saved_bytes) - int64_t(total.syncs);
+
+        std::cerr << "Mirror synchronization: skipped " << total.skipped << " of " << total.syncs
+                  << " vertex data updates, saved " << net_bytes << " bytes" << std::endl;
+
+        std::cerr << "{\"type\":\"mirror_sync\",\"algorithm\":\"" << algorithm << "\""
+                  << ",\"syncs\":" << total.syncs
+                  << ",\"skipped\":" << total.skipped
+                  << ",\"saved_bytes\":" << net_bytes << "}" << std::endl;
+    }
+}
+
+}
+
+#endif
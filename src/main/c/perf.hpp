@@ -0,0 +1,166 @@
+/*
+ * Copyright 2015 Delft University of Technology
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef PERF_HPP
+#define PERF_HPP
+
+#include <graphlab.hpp>
+#include <linux/perf_event.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <iostream>
+
+// Hardware performance counters of this process, read through perf_event_open.
+// Counters are opened with inherit set, so they include all threads created
+// after configure() is called (such as the engine's workers), but not the
+// threads that already exist at that point. If the kernel multiplexes the
+// counters, the values are scaled to the time the counters were enabled.
+namespace perf {
+
+enum counter_type {
+    CYCLES,
+    INSTRUCTIONS,
+    LLC_MISSES,
+    BRANCH_MISSES,
+    DTLB_MISSES,
+    NUM_COUNTERS
+};
+
+static const char *const COUNTER_NAMES[NUM_COUNTERS] = {
+    "cycles",
+    "instructions",
+    "llc_misses",
+    "branch_misses",
+    "dtlb_misses"
+};
+
+struct sample : public graphlab::IS_POD_TYPE {
+    uint64_t values[NUM_COUNTERS];
+
+    sample() {
+        memset(values, 0, sizeof(values));
+    }
+
+    sample& operator+=(const sample &other) {
+        for (int i = 0; i < NUM_COUNTERS; i++) values[i] += other.values[i];
+        return *this;
+    }
+
+    // Scaling of multiplexed counters can make a later reading slightly
+    // smaller than an earlier one, so differences are clamped at zero.
+    sample& operator-=(const sample &other) {
+        for (int i = 0; i < NUM_COUNTERS; i++) {
+            values[i] = values[i] > other.values[i] ? values[i] - other.values[i] : 0;
+        }
+
+        return *this;
+    }
+};
+
+static int global_fds[NUM_COUNTERS] = {-1, -1, -1, -1, -1};
+static bool global_enabled;
+static bool global_supersteps;
+
+static int open_counter(uint32_t type, uint64_t config) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.inherit = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+    return syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+// Opens the counters if enabled. Counters that are not supported by the
+// hardware or not permitted by the kernel always read as zero.
+inline void configure(bool enabled, bool supersteps) {
+    global_enabled = enabled;
+    global_supersteps = enabled && supersteps;
+
+    if (!enabled) {
+        return;
+    }
+
+    const uint64_t dtlb_read_miss = PERF_COUNT_HW_CACHE_DTLB
+                                  | (PERF_COUNT_HW_CACHE_OP_READ << 8)
+                                  | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+
+    global_fds[CYCLES] = open_counter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+    global_fds[INSTRUCTIONS] = open_counter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+    global_fds[LLC_MISSES] = open_counter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+    global_fds[BRANCH_MISSES] = open_counter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES);
+    global_fds[DTLB_MISSES] = open_counter(PERF_TYPE_HW_CACHE, dtlb_read_miss);
+
+    for (int i = 0; i < NUM_COUNTERS; i++) {
+        if (global_fds[i] < 0) {
+            std::cerr << "Hardware counter " << COUNTER_NAMES[i] << " is not available" << std::endl;
+        }
+    }
+}
+
+static bool enabled() {
+    return global_enabled;
+}
+
+static bool supersteps_enabled() {
+    return global_supersteps;
+}
+
+static sample read() {
+    sample s;
+
+    for (int i = 0; i < NUM_COUNTERS; i++) {
+        uint64_t data[3]; // value, time enabled, time running
+
+        if (global_fds[i] < 0 || ::read(global_fds[i], data, sizeof(data)) != sizeof(data)) {
+            continue;
+        }
+
+        if (data[2] > 0 && data[2] < data[1]) {
+            s.values[i] = uint64_t(double(data[0]) * data[1] / data[2]);
+        } else {
+            s.values[i] = data[0];
+        }
+    }
+
+    return s;
+}
+
+// Writes the counters as JSON fields, starting with a comma
+static void write_json(std::ostream &out, const sample &s) {
+    for (int i = 0; i < NUM_COUNTERS; i++) {
+        out << ",\"" << COUNTER_NAMES[i] << "\":" << s.values[i];
+    }
+}
+
+static void write_text(std::ostream &out, const sample &s) {
+    for (int i = 0; i < NUM_COUNTERS; i++) {
+        out << (i > 0 ? ", " : "") << COUNTER_NAMES[i] << " " << s.values[i];
+    }
+
+    if (s.values[CYCLES] > 0 && s.values[INSTRUCTIONS] > 0) {
+        out << ", IPC " << double(s.values[INSTRUCTIONS]) / s.values[CYCLES];
+    }
+}
+
+}
+
+#endif
@@ -0,0 +1,176 @@
+/*
+ * Copyright 2015 Delft University of Technology
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef PLACEMENT_HPP
+#define PLACEMENT_HPP
+
+#include <graphlab.hpp>
+#include <glob.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Placement of the ranks on the CPUs and NUMA nodes of their machine. With
+// the numa placement of run-mpi.sh, every rank is bound to the CPUs of one
+// socket. Memory is not allocated per NUMA node here, the default policy of
+// the kernel places the pages on the node of the thread that touches them
+// first, which is the node of the socket. PowerGraph sizes its thread pools from the number of CPUs of the whole
+// machine, so the default number of threads is lowered to the CPUs the rank
+// is bound to.
+namespace placement {
+
+// CPUs this process is allowed to run on
+static std::vector<int> allowed_cpus() {
+    std::vector<int> cpus;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+
+    if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+        for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+            if (CPU_ISSET(cpu, &set)) {
+                cpus.push_back(cpu);
+            }
+        }
+    }
+
+    return cpus;
+}
+
+// Parses a list of CPUs like "0-7,16-23"
+static std::vector<int> parse_cpu_list(const char *list) {
+    std::vector<int> cpus;
+    const char *p = list;
+
+    while (*p != '\0' && *p != '\n') {
+        char *end;
+        int first = strtol(p, &end, 10);
+        int last = first;
+
+        if (end == p) break;
+        if (*end == '-') last = strtol(end + 1, &end, 10);
+
+        for (int cpu = first; cpu <= last; cpu++) {
+            cpus.push_back(cpu);
+        }
+
+        p = *end == ',' ? end + 1 : end;
+    }
+
+    return cpus;
+}
+
+// NUMA nodes having at least one of the given CPUs, empty if the kernel does
+// not report any nodes
+static std::vector<int> numa_nodes(const std::vector<int> &cpus) {
+    std::vector<int> nodes;
+    glob_t matches;
+
+    if (glob("/sys/devices/system/node/node[0-9]*/cpulist", 0, NULL, &matches) == 0) {
+        for (size_t i = 0; i < matches.gl_pathc; i++) {
+            FILE *f = fopen(matches.gl_pathv[i], "r");
+            char line[4096];
+
+            if (f == NULL) continue;
+
+            if (fgets(line, sizeof(line), f) != NULL) {
+                std::vector<int> node_cpus = parse_cpu_list(line);
+                int node = atoi(strstr(matches.gl_pathv[i], "/node/node") + strlen("/node/node"));
+
+                for (size_t j = 0; j < node_cpus.size(); j++) {
+                    if (std::count(cpus.begin(), cpus.end(), node_cpus[j]) > 0) {
+                        nodes.push_back(node);
+                        break;
+                    }
+                }
+            }
+
+            fclose(f);
+        }
+    }
+
+    globfree(&matches);
+    std::sort(nodes.begin(), nodes.end());
+    return nodes;
+}
+
+// Uses one thread per allowed CPU if this process is bound to part of the
+// machine and the number of threads was not given with --ncpus.
+static void configure(graphlab::command_line_options &clopts, int argc, char **argv) {
+    for (int i = 1; i < argc; i++) {
+        if (strncmp(argv[i], "--ncpus", strlen("--ncpus")) == 0) {
+            return;
+        }
+    }
+
+    size_t num_cpus = allowed_cpus().size();
+    long machine_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+    if (num_cpus > 0 && machine_cpus > 0 && num_cpus < size_t(machine_cpus)) {
+        clopts.set_ncpus(num_cpus);
+    }
+}
+
+static std::string join(const std::vector<int> &items) {
+    std::ostringstream out;
+
+    for (size_t i = 0; i < items.size(); i++) {
+        out << (i > 0 ? "," : "") << items[i];
+    }
+
+    return out.str();
+}
+
+// Writes the host, the CPUs and NUMA nodes and the number of threads of every
+// rank to stderr of the master, as text and as JSON records.
+static void report(graphlab::distributed_control &dc, size_t num_threads) {
+    std::vector<int> cpus = allowed_cpus();
+    std::vector<int> nodes = numa_nodes(cpus);
+
+    char host[256] = "";
+    gethostname(host, sizeof(host) - 1);
+
+    std::ostringstream record;
+    record << "{\"type\":\"placement\",\"rank\":" << dc.procid()
+           << ",\"host\":\"" << host << "\""
+           << ",\"cpus\":" << cpus.size()
+           << ",\"cpu_list\":[" << join(cpus) << "]"
+           << ",\"numa_nodes\":[" << join(nodes) << "]"
+           << ",\"threads\":" << num_threads << "}";
+
+    std::vector<std::string> records(dc.numprocs());
+    records[dc.procid()] = record.str();
+    dc.all_gather(records);
+
+    if (dc.procid() == 0) {
+        std::cerr << "Placement: " << dc.numprocs() << " ranks, rank 0 on " << host << " with "
+                  << cpus.size() << " CPUs on NUMA node(s) " << (nodes.empty() ? "?" : join(nodes))
+                  << " and " << num_threads << " threads" << std::endl;
+
+        for (size_t i = 0; i < records.size(); i++) {
+            std::cerr << records[i] << std::endl;
+        }
+    }
+}
+
+}
+
+#endif
@@ -14,10 +14,14 @@
  * limitations under the License.
  */
 #include <graphlab.hpp>
+#include <cmath>
 #include <limits>
 
 #include "algorithms.hpp"
 #include "utils.hpp"
+#include "metrics.hpp"
+#include "checkpoint.hpp"
+#include "incremental.hpp"
 
 #ifdef GRANULA
 #include "granula.hpp"
@@ -31,7 +35,13 @@ using namespace std;
 
 static double global_damping_factor;
 static double global_dangling_total;
-static bool global_directed;
+
+// Runs stop once the ranks changed less than the tolerance in total (L1) in
+// an iteration, if the tolerance is positive. The change of every vertex in
+// the last iteration is kept in a column, which starts at infinity since the
+// engine may aggregate before the first iteration.
+static double global_tolerance;
+static vertex_column<double> global_change;
 
 typedef double vertex_data_type;
 typedef vertex_data_type gather_type;
@@ -42,31 +52,49 @@ void init_vertex(graph_type::vertex_type &vertex, size_t num_vertices) {
     vertex.data() = 1.0 / num_vertices;
 }
 
+// Incremental runs start from the ranks of the previous run, which are close
+// to the result if only a few edges changed
+typedef incremental::prior_result<vertex_data_type> prior_type;
+
+void init_prior(graph_type::vertex_type &vertex, const prior_type &prior, size_t num_vertices) {
+    vertex.data() = prior.get(vertex.id(), 1.0 / num_vertices);
+}
+
+// Edges of undirected graphs are stored once, so both directions count
+// towards the degree.
+template <bool directed, typename V>
+int out_degree(const V &vertex) {
+    return vertex.num_out_edges() + (directed ? 0 : vertex.num_in_edges());
+}
 
+// The vertex program is instantiated for directed and undirected graphs so
+// the gather of every edge does not need to test the direction.
+template <bool directed>
 class pagerank :
     public graphlab::ivertex_program<graph_type, gather_type>,
     public graphlab::IS_POD_TYPE {
 
     public:
         edge_dir_type gather_edges(icontext_type& context, const vertex_type& vertex) const {
-            return global_directed ? graphlab::IN_EDGES : graphlab::ALL_EDGES;
+            return directed ? graphlab::IN_EDGES : graphlab::ALL_EDGES;
         }
 
         gather_type gather(icontext_type& context, const vertex_type& vertex, edge_type& edge) const {
-            const vertex_type& other = edge.source().id() == vertex.id() ? edge.target() : edge.source();
-
-            double v = other.data();
-            int d = other.num_out_edges() + (global_directed ? 0 : other.num_in_edges());
-
-            return gather_type(v / d);
+            const vertex_type& other = directed || edge.target().id() == vertex.id() ? edge.source() : edge.target();
+            return gather_type(other.data() / out_degree<directed>(other));
         }
 
         void apply(icontext_type& context, vertex_type& vertex, const gather_type &total) {
             size_t num_vertices = context.num_vertices();
+            vertex_data_type old_rank = vertex.data();
 
             vertex.data() = (1.0 - global_damping_factor) / num_vertices
                           + global_damping_factor * (total + global_dangling_total / num_vertices);
 
+            if (global_tolerance > 0) {
+                global_change[vertex] = std::fabs(vertex.data() - old_rank);
+            }
+
             context.signal(vertex);
         }
 
@@ -75,11 +103,9 @@ class pagerank :
         }
 };
 
-template <typename engine_type>
+template <typename engine_type, bool directed>
 vertex_data_type get_vertex_data(typename engine_type::icontext_type& context, const graph_type::vertex_type& vertex) {
-    int out_degree = vertex.num_out_edges() + (global_directed ? 0 : vertex.num_in_edges());
-
-    if (out_degree == 0) {
+    if (out_degree<directed>(vertex) == 0) {
         return vertex.data();
     } else {
         return 0.0;
@@ -91,11 +117,53 @@ void set_total_residual(typename engine_type::icontext_type& context, vertex_dat
     global_dangling_total = total;
 }
 
+template <typename engine_type>
+double get_vertex_change(typename engine_type::icontext_type& context, const graph_type::vertex_type& vertex) {
+    return global_change[vertex];
+}
+
+template <typename engine_type>
+void stop_if_converged(typename engine_type::icontext_type& context, double total) {
+    if (total < global_tolerance) {
+        if (context.procid() == 0) {
+            std::cerr << "Converged after iteration " << context.iteration()
+                      << ", total change " << total << std::endl;
+        }
+
+        context.stop();
+    }
+}
+
+
+typedef graphlab::omni_engine<metrics::instrumented<pagerank<true> > > directed_engine_type;
+typedef graphlab::omni_engine<metrics::instrumented<pagerank<false> > > undirected_engine_type;
+
+// Signals all vertices. After each iteration, we need to collect the sum of
+// vertices which are dangling (i.e., no outgoing edges).
+template <typename engine_type, bool directed>
+void prepare_engine(engine_type &engine) {
+    engine.signal_all();
+
+    engine.template add_vertex_aggregator<vertex_data_type>("residual",
+                                                   &get_vertex_data<engine_type, directed>,
+                                                   &set_total_residual<engine_type>);
+
+    engine.aggregate_now("residual");
+    engine.aggregate_periodic("residual", 0);
+
+    if (global_tolerance > 0) {
+        engine.template add_vertex_aggregator<double>("change",
+                                                     &get_vertex_change<engine_type>,
+                                                     &stop_if_converged<engine_type>);
+
+        engine.aggregate_periodic("change", 0);
+    }
+}
+
 
-void run(context_t &ctx, bool directed, double damping_factor, int max_iter, string job_id) {
-    typedef graphlab::omni_engine<pagerank> engine_type;
+void run(context_t &ctx, bool directed, double damping_factor, int max_iter, double tolerance, string job_id) {
     bool is_master = ctx.dc.procid() == 0;
-    timer_start(is_master);
+    timer_start();
 
 #ifdef GRANULA
     granula::startMonitorProcess(getpid());
@@ -111,18 +179,40 @@ void run(context_t &ctx, bool directed, double damping_factor, int max_iter, str
 #endif
 
     // process parameters
-    global_directed = directed;
     global_damping_factor = damping_factor;
-    ctx.clopts.engine_args.set_option("max_iterations", max_iter);
+    global_tolerance = tolerance;
+
 
+    // check memory budget
+    size_t memory_estimate = memory::estimate(ctx,
+            sizeof(vertex_data_type) + sizeof(pagerank<true>) + sizeof(gather_type), 0);
 
+    if (memory::exceeds_budget(ctx, "pr", memory_estimate)) {
+        memory::abort_over_budget(ctx);
+    }
 
-    // load graph
+    // load graph, or restore it from a checkpoint
     timer_next("load graph");
     graph_type graph(ctx.dc);
-    load_graph(graph, ctx);
-    graph.finalize();
-    graph.transform_vertices(boost::bind(init_vertex, _1, graph.num_vertices()));
+    size_t superstep = checkpoint::resume(ctx, graph, "pr");
+
+    if (superstep == 0) {
+        load_graph(graph, ctx);
+        graph.finalize();
+        checkpoint::save_partition(ctx, graph, "pr");
+
+        if (!ctx.prior_result.empty()) {
+            prior_type prior;
+            prior.read(ctx, graph);
+            graph.transform_vertices(boost::bind(init_prior, _1, boost::cref(prior), graph.num_vertices()));
+        } else {
+            graph.transform_vertices(boost::bind(init_vertex, _1, graph.num_vertices()));
+        }
+    }
+
+    if (tolerance > 0) {
+        global_change.assign(graph, numeric_limits<double>::infinity());
+    }
 
 #ifdef GRANULA
     if(is_master) {
@@ -130,19 +220,6 @@ void run(context_t &ctx, bool directed, double damping_factor, int max_iter, str
     }
 #endif
 
-    // load engine
-    timer_next("initialize engine");
-    engine_type engine(ctx.dc, graph, "synchronous", ctx.clopts);
-    engine.signal_all();
-
-    // After each iteration, we need to collect the sum of vertices which are dangling (i.e., no outgoing edges)
-    engine.add_vertex_aggregator<vertex_data_type>("residual",
-                                                   &get_vertex_data<engine_type>,
-                                                   &set_total_residual<engine_type>);
-
-    engine.aggregate_now("residual");
-    engine.aggregate_periodic("residual", 0);
-
 #ifdef GRANULA
     granula::operation processGraph("PowerGraph", "Id.Unique", "ProcessGraph", "Id.Unique");
     if(is_master) {
@@ -150,9 +227,16 @@ void run(context_t &ctx, bool directed, double damping_factor, int max_iter, str
     }
 #endif
 
-    // run algorithm
-    timer_next("run algorithm");
-    engine.start();
+    // load engine and run algorithm, in segments if checkpoints are enabled
+    if (directed) {
+        checkpoint::run<directed_engine_type>(ctx, graph, "pr", superstep, max_iter,
+                                              prepare_engine<directed_engine_type, true>);
+    } else {
+        checkpoint::run<undirected_engine_type>(ctx, graph, "pr", superstep, max_iter,
+                                                prepare_engine<undirected_engine_type, false>);
+    }
+
+    global_change.clear();
 
 #ifdef GRANULA
     if(is_master) {
@@ -180,7 +264,8 @@ void run(context_t &ctx, bool directed, double damping_factor, int max_iter, str
          }
     }
 
-    timer_end();
+    timer_end(ctx.dc);
+    metrics::report(ctx.dc, "pr");
 
 #ifdef GRANULA
     if(is_master) {
@@ -0,0 +1,652 @@
+/*
+ * Copyright 2015 Delft University of Technology
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <graphlab.hpp>
+#include <omp.h>
+#include <stdint.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <limits>
+#include <vector>
+
+#include "algorithms.hpp"
+#include "csr.hpp"
+#include "intersect.hpp"
+#include "steal.hpp"
+#include "utils.hpp"
+
+#ifdef GRANULA
+#include "granula.hpp"
+#endif
+
+// Shared-memory backend for runs on a single machine. The graph is loaded
+// into a CSR (see csr.hpp) and every algorithm is a sequence of OpenMP loops
+// over its vertices, without the mirrors, message buffers and per-vertex
+// dispatch of the engine. The algorithms compute the same values as their
+// vertex programs, the output is written in the order of the vertex ids.
+namespace graphalytics {
+namespace shm {
+
+using namespace std;
+
+typedef graphlab::vertex_id_type vertex_id_type;
+typedef csr::vertex_index vertex_index;
+
+const uint32_t UNREACHED = numeric_limits<uint32_t>::max();
+
+// Calls expand(v, next) for every vertex of the frontier, where expand
+// appends the vertices to visit in the next round to a thread-local list.
+template <typename F>
+void advance(const vector<vertex_index> &frontier, vector<vertex_index> &next, const F &expand) {
+    next.clear();
+
+    #pragma omp parallel
+    {
+        vector<vertex_index> local;
+
+        #pragma omp for schedule(dynamic, 64) nowait
+        for (size_t i = 0; i < frontier.size(); i++) {
+            expand(frontier[i], local);
+        }
+
+        #pragma omp critical
+        next.insert(next.end(), local.begin(), local.end());
+    }
+}
+
+// Level-synchronous search, a vertex is claimed by the first thread that
+// sets its depth
+void bfs(const csr::graph<graphlab::empty> &graph, size_t source, vector<uint32_t> &depth) {
+    depth.assign(graph.num_vertices(), UNREACHED);
+
+    if (source == graph.num_vertices()) {
+        return;
+    }
+
+    vector<vertex_index> frontier(1, vertex_index(source)), next;
+    depth[source] = 0;
+
+    for (uint32_t level = 1; !frontier.empty(); level++) {
+        advance(frontier, next, [&](vertex_index u, vector<vertex_index> &local) {
+            for (const vertex_index *it = graph.out_begin(u); it != graph.out_end(u); it++) {
+                if (depth[*it] == UNREACHED && __sync_bool_compare_and_swap(&depth[*it], UNREACHED, level)) {
+                    local.push_back(*it);
+                }
+            }
+        });
+
+        frontier.swap(next);
+    }
+}
+
+// Lowers the value to the given distance, returns false if it was not larger
+static bool atomic_min(double &value, double distance) {
+    double current = value;
+
+    while (distance < current) {
+        uint64_t expected, desired;
+        memcpy(&expected, &current, sizeof(double));
+        memcpy(&desired, &distance, sizeof(double));
+
+        if (__sync_bool_compare_and_swap(reinterpret_cast<uint64_t*>(&value), expected, desired)) {
+            return true;
+        }
+
+        current = value;
+    }
+
+    return false;
+}
+
+// Bellman-Ford restricted to the vertices whose distance changed in the
+// previous round. The distances converge to the same minimum over all paths
+// as the vertex program, independent of the order of the updates.
+void sssp(const csr::graph<double> &graph, size_t source, vector<double> &distance) {
+    distance.assign(graph.num_vertices(), numeric_limits<double>::max());
+
+    if (source == graph.num_vertices()) {
+        return;
+    }
+
+    vector<vertex_index> frontier(1, vertex_index(source)), next;
+    vector<uint8_t> queued(graph.num_vertices(), 0);
+    distance[source] = 0.0;
+
+    while (!frontier.empty()) {
+        advance(frontier, next, [&](vertex_index u, vector<vertex_index> &local) {
+            const double *weight = graph.out_edge_data(u);
+            double base = distance[u];
+
+            for (const vertex_index *it = graph.out_begin(u); it != graph.out_end(u); it++, weight++) {
+                if (atomic_min(distance[*it], base + *weight) && __sync_bool_compare_and_swap(&queued[*it], 0, 1)) {
+                    local.push_back(*it);
+                }
+            }
+        });
+
+        #pragma omp parallel for
+        for (size_t i = 0; i < next.size(); i++) {
+            queued[next[i]] = 0;
+        }
+
+        frontier.swap(next);
+    }
+}
+
+// Path halving: every visited vertex is linked to its grandparent. Only the
+// CAS of the caller links roots, so a failed CAS here only skips a shortcut.
+static vertex_index find_root(vector<vertex_index> &parent, vertex_index v) {
+    while (true) {
+        vertex_index p = parent[v];
+
+        if (p == v) {
+            return v;
+        }
+
+        vertex_index g = parent[p];
+
+        if (g != p) {
+            __sync_bool_compare_and_swap(&parent[v], p, g);
+        }
+
+        v = g;
+    }
+}
+
+// Concurrent union-find. A root is always linked to a root with a lower
+// index, so every component ends up with its lowest id as label like in the
+// vertex program.
+void wcc(const csr::graph<graphlab::empty> &graph, vector<vertex_id_type> &label) {
+    size_t n = graph.num_vertices();
+    vector<vertex_index> parent(n);
+
+    #pragma omp parallel for
+    for (size_t v = 0; v < n; v++) {
+        parent[v] = vertex_index(v);
+    }
+
+    #pragma omp parallel for schedule(dynamic, 1024)
+    for (size_t v = 0; v < n; v++) {
+        for (const vertex_index *it = graph.out_begin(v); it != graph.out_end(v); it++) {
+            while (true) {
+                vertex_index a = find_root(parent, vertex_index(v));
+                vertex_index b = find_root(parent, *it);
+
+                if (a == b) break;
+                if (a < b) swap(a, b);
+                if (__sync_bool_compare_and_swap(&parent[a], a, b)) break;
+            }
+        }
+    }
+
+    label.resize(n);
+
+    #pragma omp parallel for
+    for (size_t v = 0; v < n; v++) {
+        label[v] = graph.ids[find_root(parent, vertex_index(v))];
+    }
+}
+
+// Same iterations as the vertex program: the rank of the vertices without
+// outgoing edges is spread over all vertices. For undirected graphs, the out
+// lists already hold both directions of every edge.
+void pr(const csr::graph<graphlab::empty> &graph, double damping_factor, int max_iter,
+        size_t grain, vector<double> &rank) {
+
+    size_t n = graph.num_vertices();
+    const vector<size_t> &offsets = graph.in_edge_offsets();
+    const vertex_index *sources = graph.in_edge_sources();
+    steal::plan plan(offsets, grain, omp_get_max_threads());
+    vector<double> contribution(n);
+    rank.assign(n, 1.0 / n);
+
+    for (int iteration = 0; iteration < max_iter; iteration++) {
+        double dangling_total = 0.0;
+
+        #pragma omp parallel for reduction(+:dangling_total)
+        for (size_t v = 0; v < n; v++) {
+            size_t degree = graph.out_degree(v);
+
+            if (degree == 0) {
+                dangling_total += rank[v];
+                contribution[v] = 0.0;
+            } else {
+                contribution[v] = rank[v] / degree;
+            }
+        }
+
+        plan.gather_apply<double>(offsets,
+            [&](size_t v, size_t first, size_t last, double &total) {
+                for (size_t e = first; e < last; e++) {
+                    total += contribution[sources[e]];
+                }
+            },
+            [&](size_t v, double &total) {
+                rank[v] = (1.0 - damping_factor) / n + damping_factor * (total + dangling_total / n);
+            });
+    }
+
+    plan.stats.report("pr", plan.splits.size());
+}
+
+// Frequencies of the labels of the neighbors of a vertex, sorted by label.
+// The histograms of the parts of a split vertex are merged with +=.
+struct label_runs {
+    vector<pair<vertex_id_type, size_t> > runs;
+
+    void clear() {
+        runs.clear();
+    }
+
+    label_runs& operator +=(const label_runs &other) {
+        vector<pair<vertex_id_type, size_t> > merged;
+        size_t i = 0, j = 0;
+
+        while (i < runs.size() || j < other.runs.size()) {
+            if (j == other.runs.size() || (i < runs.size() && runs[i].first < other.runs[j].first)) {
+                merged.push_back(runs[i++]);
+            } else if (i == runs.size() || other.runs[j].first < runs[i].first) {
+                merged.push_back(other.runs[j++]);
+            } else {
+                merged.push_back(make_pair(runs[i].first, runs[i].second + other.runs[j].second));
+                i++;
+                j++;
+            }
+        }
+
+        runs.swap(merged);
+        return *this;
+    }
+};
+
+// Synchronous label propagation over the in and out edges. Ties go to the
+// lowest label and a vertex without neighbors gets label 0, as in cdlp.cpp.
+// Stops early if no label changes. The edges of a vertex are numbered with
+// the out-edges first, followed by the in-edges of directed graphs.
+void cdlp(const csr::graph<graphlab::empty> &graph, int max_iter, size_t grain, vector<vertex_id_type> &label) {
+    size_t n = graph.num_vertices();
+    vector<size_t> offsets(n + 1, 0);
+
+    for (size_t v = 0; v < n; v++) {
+        offsets[v + 1] = offsets[v] + graph.out_degree(v) + (graph.directed ? graph.in_degree(v) : 0);
+    }
+
+    steal::plan plan(offsets, grain, omp_get_max_threads());
+    vector<vector<vertex_id_type> > scratch(plan.num_threads());
+    vector<vertex_id_type> next(n);
+    label = graph.ids;
+
+    for (int iteration = 0; iteration < max_iter; iteration++) {
+        std::atomic<size_t> changed(0);
+
+        plan.gather_apply<label_runs>(offsets,
+            [&](size_t v, size_t first, size_t last, label_runs &total) {
+                vector<vertex_id_type> &labels = scratch[omp_get_thread_num()];
+                size_t out_degree = graph.out_degree(v);
+                size_t begin = first - offsets[v], end = last - offsets[v];
+                labels.clear();
+
+                for (const vertex_index *it = graph.out_begin(v) + min(begin, out_degree),
+                        *it_end = graph.out_begin(v) + min(end, out_degree); it != it_end; it++) {
+                    labels.push_back(label[*it]);
+                }
+
+                for (const vertex_index *it = graph.in_begin(v) + (max(begin, out_degree) - out_degree),
+                        *it_end = graph.in_begin(v) + (max(end, out_degree) - out_degree); it != it_end; it++) {
+                    labels.push_back(label[*it]);
+                }
+
+                sort(labels.begin(), labels.end());
+
+                for (size_t i = 0, j = 0; i < labels.size(); i = j) {
+                    while (j < labels.size() && labels[j] == labels[i]) j++;
+                    total.runs.push_back(make_pair(labels[i], j - i));
+                }
+            },
+            [&](size_t v, label_runs &total) {
+                vertex_id_type best_label = 0;
+                size_t best_freq = 0;
+
+                for (size_t i = 0; i < total.runs.size(); i++) {
+                    if (total.runs[i].second > best_freq) {
+                        best_label = total.runs[i].first;
+                        best_freq = total.runs[i].second;
+                    }
+                }
+
+                next[v] = best_label;
+                if (best_label != label[v]) changed++;
+            });
+
+        label.swap(next);
+
+        if (changed == 0) {
+            break;
+        }
+    }
+
+    plan.stats.report("cdlp", plan.splits.size());
+}
+
+// Neighbors of every vertex without duplicates, with the number of edges
+// between the vertex and each neighbor (1 or 2, only 2 if the graph is
+// undirected or has edges in both directions)
+static void unique_neighbors(const csr::graph<graphlab::empty> &graph, vector<size_t> &offsets,
+                             vector<vertex_index> &neighbors, vector<uint8_t> &multiplicity) {
+    size_t n = graph.num_vertices();
+    vector<size_t> degree(n + 1, 0);
+
+    #pragma omp parallel for schedule(dynamic, 1024)
+    for (size_t v = 0; v < n; v++) {
+        const vertex_index *a = graph.out_begin(v), *a_end = graph.out_end(v);
+        const vertex_index *b = graph.in_begin(v), *b_end = graph.in_end(v);
+        size_t count = 0;
+
+        while (a != a_end || b != b_end) {
+            vertex_index next = a == a_end ? *b : b == b_end ? *a : min(*a, *b);
+            while (a != a_end && *a == next) a++;
+            while (b != b_end && *b == next) b++;
+            count++;
+        }
+
+        degree[v] = count;
+    }
+
+    offsets.assign(n + 1, 0);
+
+    for (size_t v = 0; v < n; v++) {
+        offsets[v + 1] = offsets[v] + degree[v];
+    }
+
+    neighbors.resize(offsets[n]);
+    multiplicity.resize(offsets[n]);
+
+    #pragma omp parallel for schedule(dynamic, 1024)
+    for (size_t v = 0; v < n; v++) {
+        const vertex_index *a = graph.out_begin(v), *a_end = graph.out_end(v);
+        const vertex_index *b = graph.in_begin(v), *b_end = graph.in_end(v);
+        size_t p = offsets[v];
+
+        while (a != a_end || b != b_end) {
+            vertex_index next = a == a_end ? *b : b == b_end ? *a : min(*a, *b);
+            bool out = false, in = false;
+
+            while (a != a_end && *a == next) a++, out = true;
+            while (b != b_end && *b == next) b++, in = true;
+
+            neighbors[p] = next;
+            multiplicity[p] = graph.directed ? uint8_t(out) + uint8_t(in) : 2;
+            p++;
+        }
+    }
+}
+
+// Called for every triangle (v, u, w) found through the edges v-u, v-w and
+// u-w. Every vertex is credited with the number of edges between the other
+// two, the credit of v is summed locally since v is fixed per thread.
+struct triangle_credit {
+    vector<size_t> &triangles;
+    const vertex_index *v_neighbors, *u_neighbors;
+    const uint8_t *v_multiplicity, *u_multiplicity;
+    vertex_index u;
+    uint8_t vu_multiplicity;
+    size_t v_credit;
+
+    triangle_credit(vector<size_t> &triangles) : triangles(triangles), v_credit(0) {
+        //
+    }
+
+    void operator()(size_t i, size_t j) {
+        v_credit += u_multiplicity[j];
+        __sync_fetch_and_add(&triangles[u], size_t(v_multiplicity[i]));
+        __sync_fetch_and_add(&triangles[v_neighbors[i]], size_t(vu_multiplicity));
+    }
+};
+
+// Finds every triangle once by only following edges to neighbors of higher
+// degree (ties broken by index), which also bounds the length of the lists
+// intersected for hubs. The intersections of every forward edge are the
+// gather over that edge, so the forward lists are divided over the threads.
+// The number of edges between the neighbors of every vertex counts both
+// directions of undirected edges, so the coefficient is the same as in
+// lcc.cpp.
+void lcc(const csr::graph<graphlab::empty> &graph, size_t grain, vector<double> &coefficient) {
+    size_t n = graph.num_vertices();
+    vector<size_t> offsets;
+    vector<vertex_index> neighbors;
+    vector<uint8_t> multiplicity;
+
+    unique_neighbors(graph, offsets, neighbors, multiplicity);
+
+    // Forward lists, a sorted subset of the unique neighbors
+    vector<size_t> forward_offsets(n + 1, 0);
+    vector<vertex_index> forward;
+    vector<uint8_t> forward_multiplicity;
+
+    auto precedes = [&](size_t a, size_t b) {
+        size_t degree_a = offsets[a + 1] - offsets[a], degree_b = offsets[b + 1] - offsets[b];
+        return degree_a < degree_b || (degree_a == degree_b && a < b);
+    };
+
+    #pragma omp parallel for schedule(dynamic, 1024)
+    for (size_t v = 0; v < n; v++) {
+        size_t count = 0;
+
+        for (size_t p = offsets[v]; p < offsets[v + 1]; p++) {
+            if (precedes(v, neighbors[p])) count++;
+        }
+
+        forward_offsets[v + 1] = count;
+    }
+
+    for (size_t v = 0; v < n; v++) {
+        forward_offsets[v + 1] += forward_offsets[v];
+    }
+
+    forward.resize(forward_offsets[n]);
+    forward_multiplicity.resize(forward_offsets[n]);
+
+    #pragma omp parallel for schedule(dynamic, 1024)
+    for (size_t v = 0; v < n; v++) {
+        size_t q = forward_offsets[v];
+
+        for (size_t p = offsets[v]; p < offsets[v + 1]; p++) {
+            if (precedes(v, neighbors[p])) {
+                forward[q] = neighbors[p];
+                forward_multiplicity[q] = multiplicity[p];
+                q++;
+            }
+        }
+    }
+
+    vector<size_t> triangles(n, 0);
+    steal::plan plan(forward_offsets, grain, omp_get_max_threads());
+
+    plan.gather_apply<size_t>(forward_offsets,
+        [&](size_t v, size_t first, size_t last, size_t &total) {
+            triangle_credit match(triangles);
+            size_t v_begin = forward_offsets[v], v_size = forward_offsets[v + 1] - v_begin;
+
+            match.v_neighbors = forward.data() + v_begin;
+            match.v_multiplicity = forward_multiplicity.data() + v_begin;
+
+            for (size_t k = first; k < last; k++) {
+                vertex_index u = forward[k];
+                size_t u_begin = forward_offsets[u], u_size = forward_offsets[u + 1] - u_begin;
+
+                match.u = u;
+                match.u_neighbors = forward.data() + u_begin;
+                match.u_multiplicity = forward_multiplicity.data() + u_begin;
+                match.vu_multiplicity = forward_multiplicity[k];
+
+                intersect::sorted(match.v_neighbors, v_size, match.u_neighbors, u_size, match);
+            }
+
+            total += match.v_credit;
+        },
+        [&](size_t v, size_t &total) {
+            __sync_fetch_and_add(&triangles[v], total);
+        });
+
+    plan.stats.report("lcc", plan.splits.size());
+
+    coefficient.resize(n);
+
+    #pragma omp parallel for
+    for (size_t v = 0; v < n; v++) {
+        coefficient[v] = lcc::clustering_coefficient(offsets[v + 1] - offsets[v], triangles[v]);
+    }
+}
+
+template <typename E, typename F>
+bool load(context_t &ctx, csr::graph<E> &graph, bool directed, const F &edge_parser) {
+    if (!graph.load(ctx.vertex_file, ctx.edge_file, directed, edge_parser)) {
+        return false;
+    }
+
+    cerr << "Loaded " << graph.num_vertices() << " vertices and " << graph.num_edges
+         << " edges with " << omp_get_max_threads() << " threads" << endl;
+
+    return true;
+}
+
+template <typename E, typename T, typename F>
+void print(context_t &ctx, const csr::graph<E> &graph, const vector<T> &values, const F &format) {
+    ostream &out = *ctx.output_stream;
+
+    for (size_t v = 0; v < graph.num_vertices(); v++) {
+        out << graph.ids[v] << " ";
+        format(out, values[v]);
+        out << '\n';
+    }
+
+    out.flush();
+}
+
+template <typename T>
+void print_value(ostream &out, const T &value) {
+    out << value;
+}
+
+bool run(context_t &ctx, const string &algorithm, bool directed, vertex_id_type source,
+         double damping_factor, int max_iter, size_t grain, string job_id) {
+
+    bool is_master = ctx.dc.procid() == 0;
+    omp_set_num_threads(ctx.clopts.get_ncpus());
+    timer_start();
+
+#ifdef GRANULA
+    granula::startMonitorProcess(getpid());
+    granula::operation powergraphJob("PowerGraph", "Id.Unique", "Job", "Id.Unique");
+    granula::operation loadGraph("PowerGraph", "Id.Unique", "LoadGraph", "Id.Unique");
+    if(is_master) {
+        cout<<powergraphJob.getOperationInfo("StartTime", powergraphJob.getEpoch())<<endl;
+        cout<<loadGraph.getOperationInfo("StartTime", loadGraph.getEpoch())<<endl;
+    }
+
+    granula::linkNode(job_id);
+    granula::linkProcess(getpid(), job_id);
+    granula::operation processGraph("PowerGraph", "Id.Unique", "ProcessGraph", "Id.Unique");
+    granula::operation offloadGraph("PowerGraph", "Id.Unique", "OffloadGraph", "Id.Unique");
+#endif
+
+    timer_next("load graph");
+    csr::graph<graphlab::empty> graph;
+    csr::graph<double> weighted_graph;
+    bool loaded = algorithm == "sssp"
+                ? load(ctx, weighted_graph, directed, sssp::edge_data_parser)
+                : load(ctx, graph, directed, default_parser<graphlab::empty>);
+
+    if (!loaded) {
+        timer_end(ctx.dc);
+#ifdef GRANULA
+        granula::stopMonitorProcess(getpid());
+#endif
+        return false;
+    }
+
+#ifdef GRANULA
+    if(is_master) {
+        cout<<loadGraph.getOperationInfo("EndTime", loadGraph.getEpoch())<<endl;
+        cout<<processGraph.getOperationInfo("StartTime", processGraph.getEpoch())<<endl;
+    }
+#endif
+
+    timer_next("run algorithm");
+    vector<uint32_t> depth;
+    vector<double> values;
+    vector<vertex_id_type> labels;
+
+    if (algorithm == "bfs") {
+        bfs(graph, graph.index_of(source), depth);
+    } else if (algorithm == "sssp") {
+        sssp(weighted_graph, weighted_graph.index_of(source), values);
+    } else if (algorithm == "wcc") {
+        wcc(graph, labels);
+    } else if (algorithm == "pr") {
+        pr(graph, damping_factor, max_iter, grain, values);
+    } else if (algorithm == "cdlp") {
+        cdlp(graph, max_iter, grain, labels);
+    } else if (algorithm == "lcc") {
+        lcc(graph, grain, values);
+    }
+
+#ifdef GRANULA
+    if(is_master) {
+        cout<<processGraph.getOperationInfo("EndTime", processGraph.getEpoch())<<endl;
+        cout<<offloadGraph.getOperationInfo("StartTime", offloadGraph.getEpoch())<<endl;
+    }
+#endif
+
+    // print output, with the same values for unreached vertices as bfs.cpp
+    // and sssp.cpp
+    if (ctx.output_enabled) {
+        timer_next("print output");
+
+        if (algorithm == "bfs") {
+            print(ctx, graph, depth, [](ostream &out, uint32_t d) {
+                out << (d == UNREACHED ? uint64_t(numeric_limits<int64_t>::max()) : uint64_t(d));
+            });
+        } else if (algorithm == "sssp") {
+            print(ctx, weighted_graph, values, [](ostream &out, double d) {
+                if (d == numeric_limits<double>::max()) {
+                    out << "Infinity";
+                } else {
+                    out << d;
+                }
+            });
+        } else if (algorithm == "wcc" || algorithm == "cdlp") {
+            print(ctx, graph, labels, print_value<vertex_id_type>);
+        } else {
+            print(ctx, graph, values, print_value<double>);
+        }
+    }
+
+    timer_end(ctx.dc);
+
+#ifdef GRANULA
+    if(is_master) {
+        cout<<offloadGraph.getOperationInfo("EndTime", offloadGraph.getEpoch())<<endl;
+        cout<<powergraphJob.getOperationInfo("EndTime", powergraphJob.getEpoch())<<endl;
+    }
+    granula::stopMonitorProcess(getpid());
+#endif
+
+    return true;
+}
+
+}
+}
@@ -18,6 +18,7 @@
 
 #include "algorithms.hpp"
 #include "utils.hpp"
+#include "metrics.hpp"
 
 #ifdef GRANULA
 #include "granula.hpp"
@@ -39,9 +40,9 @@ static void init_vertex(graph_type::vertex_type &vertex) {
     vertex.data() = numeric_limits<vertex_data_type>::max();
 }
 
-static bool global_directed;
-
-
+// Directed graphs are only traversed along out-edges. The vertex program is
+// instantiated for both cases so no edge needs to test the direction.
+template <bool directed>
 class single_source_shortest_path :
     public graphlab::ivertex_program<graph_type, gather_type, msg_type>,
     public graphlab::IS_POD_TYPE {
@@ -69,14 +70,14 @@ class single_source_shortest_path :
 
         edge_dir_type scatter_edges(icontext_type& context, const vertex_type& vertex) const {
             return changed
-                    ? (global_directed
+                    ? (directed
                             ? graphlab::OUT_EDGES
                             : graphlab::ALL_EDGES)
                     : graphlab::NO_EDGES;
         }
 
         void scatter(icontext_type& context, const vertex_type& vertex, edge_type& edge) const {
-            const vertex_type& other = edge.target().id() == vertex.id() ? edge.source() : edge.target();
+            const vertex_type& other = directed || edge.source().id() == vertex.id() ? edge.target() : edge.source();
             vertex_data_type new_dist = vertex.data() + edge.data();
 
             if (other.data() > new_dist) {
@@ -92,9 +93,36 @@ bool edge_data_parser(const string &line, double &data) {
     return start < end;
 }
 
+template <typename vertex_program_type>
+void run_engine(context_t &ctx, graph_type &graph, bool is_master, graphlab::vertex_id_type source) {
+    // start engine
+    timer_next("initialize engine");
+    graphlab::omni_engine<metrics::instrumented<vertex_program_type> > engine(ctx.dc, graph, "synchronous", ctx.clopts);
+    engine.signal(source, msg_type(0.0));
+
+#ifdef GRANULA
+    granula::operation processGraph("PowerGraph", "Id.Unique", "ProcessGraph", "Id.Unique");
+    if(is_master) {
+        cout<<processGraph.getOperationInfo("StartTime", processGraph.getEpoch())<<endl;
+    }
+#endif
+
+    // run algorithm
+    timer_next("run algorithm");
+    metrics::begin_run(ctx.dc);
+    engine.start();
+    metrics::end_run(ctx.dc);
+
+#ifdef GRANULA
+    if(is_master) {
+        cout<<processGraph.getOperationInfo("EndTime", processGraph.getEpoch())<<endl;
+    }
+#endif
+}
+
 void run(context_t &ctx, bool directed, graphlab::vertex_id_type source, string job_id) {
     bool is_master = ctx.dc.procid() == 0;
-    timer_start(is_master);
+    timer_start();
 
 #ifdef GRANULA
     granula::startMonitorProcess(getpid());
@@ -109,8 +137,13 @@ void run(context_t &ctx, bool directed, graphlab::vertex_id_type source, string
     granula::linkProcess(getpid(), job_id);
 #endif
 
-    // process parameters
-    global_directed = directed;
+    // check memory budget
+    size_t memory_estimate = memory::estimate(ctx,
+            sizeof(vertex_data_type) + sizeof(single_source_shortest_path<true>) + sizeof(msg_type), sizeof(edge_data_type));
+
+    if (memory::exceeds_budget(ctx, "sssp", memory_estimate)) {
+        memory::abort_over_budget(ctx);
+    }
 
     // load graph
     timer_next("load graph");
@@ -125,27 +158,11 @@ void run(context_t &ctx, bool directed, graphlab::vertex_id_type source, string
     }
 #endif
 
-    // start engine
-    timer_next("initialize engine");
-    graphlab::omni_engine<single_source_shortest_path> engine(ctx.dc, graph, "synchronous", ctx.clopts);
-    engine.signal(source, msg_type(0.0));
-
-#ifdef GRANULA
-    granula::operation processGraph("PowerGraph", "Id.Unique", "ProcessGraph", "Id.Unique");
-    if(is_master) {
-        cout<<processGraph.getOperationInfo("StartTime", processGraph.getEpoch())<<endl;
-    }
-#endif
-
-    // run algorithm
-    timer_next("run algorithm");
-    engine.start();
-
-#ifdef GRANULA
-    if(is_master) {
-        cout<<processGraph.getOperationInfo("EndTime", processGraph.getEpoch())<<endl;
+    if (directed) {
+        run_engine<single_source_shortest_path<true> >(ctx, graph, is_master, source);
+    } else {
+        run_engine<single_source_shortest_path<false> >(ctx, graph, is_master, source);
     }
-#endif
 
 #ifdef GRANULA
     granula::operation offloadGraph("PowerGraph", "Id.Unique", "OffloadGraph", "Id.Unique");
@@ -175,7 +192,8 @@ void run(context_t &ctx, bool directed, graphlab::vertex_id_type source, string
         }
     }
 
-    timer_end();
+    timer_end(ctx.dc);
+    metrics::report(ctx.dc, "sssp");
 
 #ifdef GRANULA
     if(is_master) {
@@ -0,0 +1,326 @@
+/*
+ * Copyright 2015 Delft University of Technology
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef STEAL_HPP
+#define STEAL_HPP
+
+#include <omp.h>
+#include <algorithm>
+#include <atomic>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "utils.hpp"
+
+// Work stealing for the gather and apply loops of the shared-memory backend.
+// The edges of all vertices are cut into tasks of about --shm-grain edges:
+// light vertices are grouped, and a vertex with more edges than that is split
+// into edge ranges, so a hub does not keep one thread busy while the others
+// wait at the end of the superstep. The tasks are divided over the threads in
+// blocks of equal work, and a thread that finishes its block takes the
+// remaining tasks of the other threads. The gathers of the parts of a split
+// vertex are combined with += (as the engine combines the gathers of the
+// edges of a vertex) by the thread finishing the last part, which then
+// applies the vertex.
+namespace steal {
+
+const size_t NOT_SPLIT = std::numeric_limits<size_t>::max();
+
+struct task {
+    size_t first_vertex;
+    size_t last_vertex;
+
+    // Edge range and partial gather slot of a part of a split vertex,
+    // split is NOT_SPLIT for a task of whole vertices
+    size_t first_edge;
+    size_t last_edge;
+    size_t split;
+    size_t slot;
+};
+
+struct split_vertex {
+    size_t num_parts;
+    size_t first_slot;
+};
+
+// Next task of the block of one thread, padded to its own cache line
+struct block {
+    std::atomic<size_t> next;
+    size_t end;
+    char padding[48];
+};
+
+// Resets a gather total for the next vertex, keeping allocated memory
+template <typename A>
+void clear(A &total) {
+    total.clear();
+}
+
+inline void clear(double &total) {
+    total = 0.0;
+}
+
+inline void clear(size_t &total) {
+    total = 0;
+}
+
+// Busy and idle time, tasks and stolen tasks of every thread, summed over
+// all loops of a run
+class thread_stats {
+    public:
+        std::vector<double> busy_sec;
+        std::vector<double> idle_sec;
+        std::vector<size_t> tasks;
+        std::vector<size_t> stolen;
+        size_t loops;
+
+        thread_stats() : loops(0) {
+            //
+        }
+
+        void resize(size_t num_threads) {
+            busy_sec.resize(num_threads, 0.0);
+            idle_sec.resize(num_threads, 0.0);
+            tasks.resize(num_threads, 0);
+            stolen.resize(num_threads, 0);
+        }
+
+        // Writes the balance of the threads to stderr, as text and as a
+        // JSON record with one entry per thread in every array
+        void report(const std::string &algorithm, size_t split_vertices) const {
+            double busy = 0.0, idle = 0.0, max_busy = 0.0;
+            size_t num_stolen = 0;
+
+            for (size_t i = 0; i < busy_sec.size(); i++) {
+                busy += busy_sec[i];
+                idle += idle_sec[i];
+                max_busy = std::max(max_busy, busy_sec[i]);
+                num_stolen += stolen[i];
+            }
+
+            std::cerr << "Threads: " << busy_sec.size() << " threads busy " << busy << " sec, idle "
+                      << idle << " sec (" << (busy + idle > 0 ? 100.0 * idle / (busy + idle) : 0.0)
+                      << "% of " << loops << " loops), busiest " << max_busy << " sec, "
+                      << num_stolen << " stolen tasks, " << split_vertices << " split vertices" << std::endl;
+
+            std::cerr << "{\"type\":\"threads\",\"algorithm\":\"" << algorithm << "\""
+                      << ",\"loops\":" << loops
+                      << ",\"split_vertices\":" << split_vertices;
+
+            write_array(std::cerr, "busy_sec", busy_sec);
+            write_array(std::cerr, "idle_sec", idle_sec);
+            write_array(std::cerr, "tasks", tasks);
+            write_array(std::cerr, "stolen", stolen);
+
+            std::cerr << "}" << std::endl;
+        }
+
+    private:
+        template <typename T>
+        static void write_array(std::ostream &out, const char *name, const std::vector<T> &values) {
+            out << ",\"" << name << "\":[";
+
+            for (size_t i = 0; i < values.size(); i++) {
+                out << (i > 0 ? "," : "") << values[i];
+            }
+
+            out << "]";
+        }
+};
+
+// Tasks over the edges given by CSR offsets, which stay the same for all
+// loops of a run
+class plan {
+    public:
+        std::vector<task> tasks;
+        std::vector<split_vertex> splits;
+        std::vector<block> blocks;
+        size_t num_slots;
+        thread_stats stats;
+
+        // Cuts the edges into tasks of about grain edges, counting every
+        // vertex as one edge. With grain 0, vertices are not split.
+        plan(const std::vector<size_t> &offsets, size_t grain, size_t num_threads)
+                : blocks(num_threads), num_slots(0) {
+
+            size_t n = offsets.size() - 1;
+            size_t max_edges = grain > 0 ? grain : offsets[n] + 1;
+            size_t task_work = std::max<size_t>(grain, 1024);
+            size_t first = 0, work = 0;
+            std::vector<size_t> work_before(1, 0);
+
+            for (size_t v = 0; v < n; v++) {
+                size_t degree = offsets[v + 1] - offsets[v];
+
+                if (degree > max_edges) {
+                    add_light(first, v, work, work_before);
+
+                    split_vertex s;
+                    s.num_parts = (degree + max_edges - 1) / max_edges;
+                    s.first_slot = num_slots;
+
+                    for (size_t part = 0; part < s.num_parts; part++) {
+                        task t;
+                        t.first_vertex = v;
+                        t.last_vertex = v + 1;
+                        t.first_edge = offsets[v] + part * degree / s.num_parts;
+                        t.last_edge = offsets[v] + (part + 1) * degree / s.num_parts;
+                        t.split = splits.size();
+                        t.slot = num_slots++;
+                        tasks.push_back(t);
+                        work_before.push_back(work_before.back() + t.last_edge - t.first_edge);
+                    }
+
+                    splits.push_back(s);
+                    first = v + 1;
+                    continue;
+                }
+
+                work += degree + 1;
+
+                if (work >= task_work) {
+                    add_light(first, v + 1, work, work_before);
+                }
+            }
+
+            add_light(first, n, work, work_before);
+
+            // Contiguous blocks of equal work
+            size_t next = 0;
+
+            for (size_t i = 0; i < num_threads; i++) {
+                size_t target = work_before.back() * (i + 1) / num_threads;
+                size_t end = next;
+
+                while (end < tasks.size() && (i + 1 == num_threads || work_before[end + 1] <= target)) {
+                    end++;
+                }
+
+                blocks[i].next = next;
+                blocks[i].end = end;
+                next = end;
+            }
+
+            stats.resize(num_threads);
+        }
+
+        size_t num_threads() const {
+            return blocks.size();
+        }
+
+        // Runs gather(v, first_edge, last_edge, total) and apply(v, total)
+        // for all vertices, with a gather total of type A per vertex
+        template <typename A, typename FG, typename FA>
+        void gather_apply(const std::vector<size_t> &offsets, const FG &gather, const FA &apply) {
+            std::vector<A> slots(num_slots);
+            std::vector<std::atomic<size_t> > remaining(splits.size());
+
+            for (size_t i = 0; i < splits.size(); i++) {
+                remaining[i] = splits[i].num_parts;
+            }
+
+            std::vector<size_t> starts(blocks.size());
+            for (size_t i = 0; i < blocks.size(); i++) starts[i] = blocks[i].next;
+
+            double start = timer();
+            std::vector<double> finish(blocks.size(), start);
+
+            #pragma omp parallel num_threads(blocks.size())
+            {
+                size_t self = omp_get_thread_num();
+                size_t executed = 0, stolen = 0;
+
+                for (size_t k = 0; k < blocks.size(); k++) {
+                    block &b = blocks[(self + k) % blocks.size()];
+
+                    while (true) {
+                        size_t i = b.next.fetch_add(1);
+                        if (i >= b.end) break;
+
+                        run_task<A>(tasks[i], offsets, slots, remaining, gather, apply);
+                        executed++;
+                        if (k > 0) stolen++;
+                    }
+                }
+
+                finish[self] = timer();
+                stats.tasks[self] += executed;
+                stats.stolen[self] += stolen;
+            }
+
+            double end = timer();
+
+            for (size_t i = 0; i < blocks.size(); i++) {
+                stats.busy_sec[i] += finish[i] - start;
+                stats.idle_sec[i] += end - finish[i];
+                blocks[i].next = starts[i];
+            }
+
+            stats.loops++;
+        }
+
+    private:
+        void add_light(size_t &first, size_t last, size_t &work, std::vector<size_t> &work_before) {
+            if (first < last) {
+                task t;
+                t.first_vertex = first;
+                t.last_vertex = last;
+                t.first_edge = t.last_edge = t.slot = 0;
+                t.split = NOT_SPLIT;
+                tasks.push_back(t);
+                work_before.push_back(work_before.back() + work);
+            }
+
+            first = last;
+            work = 0;
+        }
+
+        template <typename A, typename FG, typename FA>
+        void run_task(const task &t, const std::vector<size_t> &offsets, std::vector<A> &slots,
+                      std::vector<std::atomic<size_t> > &remaining, const FG &gather, const FA &apply) {
+
+            if (t.split == NOT_SPLIT) {
+                A total = A();
+
+                for (size_t v = t.first_vertex; v < t.last_vertex; v++) {
+                    clear(total);
+                    gather(v, offsets[v], offsets[v + 1], total);
+                    apply(v, total);
+                }
+
+                return;
+            }
+
+            gather(t.first_vertex, t.first_edge, t.last_edge, slots[t.slot]);
+
+            // The last part to finish combines the partial gathers
+            if (remaining[t.split].fetch_sub(1) == 1) {
+                const split_vertex &s = splits[t.split];
+                A &total = slots[s.first_slot];
+
+                for (size_t i = 1; i < s.num_parts; i++) {
+                    total += slots[s.first_slot + i];
+                }
+
+                apply(t.first_vertex, total);
+            }
+        }
+};
+
+}
+
+#endif
@@ -19,11 +19,14 @@
 #include <graphlab.hpp>
 #include <fstream>
 #include <ostream>
-#include <sys/time.h>
+#include <chrono>
 #include <limits>
 #include <string>
 #include <vector>
 
+#include "compression.hpp"
+#include "memory.hpp"
+#include "perf.hpp"
 
 
 template <typename T>
@@ -95,7 +98,17 @@ class histogram {
         }
 
         void save(graphlab::oarchive& oarc) const {
-            if (data == NULL) {
+            if (compression::enabled()) {
+                std::vector<std::pair<T, size_t> > items;
+
+                if (data != NULL) {
+                    items.assign(data->begin(), data->end());
+                } else if (first_item != INVALID_ITEM) {
+                    items.push_back(std::make_pair(first_item, size_t(1)));
+                }
+
+                compression::save_vector(oarc, items);
+            } else if (data == NULL) {
                 map_type tmp;
                 if (first_item != INVALID_ITEM) tmp[first_item] = 1;
                 oarc << tmp;
@@ -107,7 +120,14 @@ class histogram {
         void load(graphlab::iarchive& iarc) {
             if (data) delete data;
             data = new map_type;
-            iarc >> *data;
+
+            if (compression::enabled()) {
+                std::vector<std::pair<T, size_t> > items;
+                compression::load_vector(iarc, items);
+                data->insert(items.begin(), items.end());
+            } else {
+                iarc >> *data;
+            }
         }
 
         ~histogram() {
@@ -141,6 +161,59 @@ std::pair<B, A> reverse(std::pair<A, B> p) {
     return std::make_pair(p.second, p.first);
 }
 
+// Per-vertex values stored outside the graph, in an array indexed by local
+// vertex id. Unlike the vertex data, the values are not synchronized with the
+// mirrors after apply, so a column suits state that is only used by the
+// replica that computes it, such as values accumulated by the master between
+// supersteps or results that are only written to the output.
+template <typename T>
+class vertex_column {
+    std::vector<T> values;
+
+    public:
+        template <typename G>
+        void assign(const G &graph, const T &value=T()) {
+            values.assign(graph.num_local_vertices(), value);
+        }
+
+        void clear() {
+            std::vector<T>().swap(values);
+        }
+
+        template <typename V>
+        T& operator[](const V &vertex) {
+            return values[vertex.local_id()];
+        }
+
+        T& at(size_t lvid) {
+            return values[lvid];
+        }
+
+        size_t size() const {
+            return values.size();
+        }
+};
+
+// Sends the values collected for the owned vertices to the originator
+template <typename I, typename T>
+void gather_to_originator(graphlab::distributed_control &dc,
+        std::vector<std::pair<I, T> > &result, bool originator) {
+
+    if (originator) {
+        std::vector<std::pair<I, T> > buffer;
+
+        for (size_t pid = 1; pid < dc.numprocs(); pid++) {
+            dc.recv_from(pid, buffer);
+            result.insert(result.end(), buffer.begin(), buffer.end());
+            buffer.clear();
+        }
+
+    } else {
+        dc.send_to(0, result);
+        result.clear();
+    }
+}
+
 template <typename G>
 void collect_vertex_data(G &graph,
         std::vector<std::pair<typename G::vertex_id_type,
@@ -155,20 +228,23 @@ void collect_vertex_data(G &graph,
         }
     }
 
-    if (originator) {
-        std::vector<std::pair<typename G::vertex_id_type,
-                              typename G::vertex_data_type> > buffer;
+    gather_to_originator(graph.dc(), result, originator);
+}
 
-        for (size_t pid = 1; pid < graph.dc().numprocs(); pid++) {
-            graph.dc().recv_from(pid, buffer);
-            result.insert(result.end(), buffer.begin(), buffer.end());
-            buffer.clear();
-        }
+template <typename G, typename T>
+void collect_vertex_column(G &graph, vertex_column<T> &column,
+        std::vector<std::pair<typename G::vertex_id_type, T> > &result,
+        bool originator) {
 
-    } else {
-        graph.dc().send_to(0, result);
-        result.clear();
+    for (size_t i = 0, n = graph.num_local_vertices(); i < n; i++) {
+        const typename G::local_vertex_type &v = graph.l_vertex(i);
+
+        if (v.owned()) {
+            result.push_back(std::make_pair(v.global_id(), column.at(i)));
+        }
     }
+
+    gather_to_originator(graph.dc(), result, originator);
 }
 
 template <typename D>
@@ -267,40 +343,201 @@ void load_graph(G &graph, context_t &ctx) {
 }
 
 static double timer() {
-    struct timeval tv;
-    gettimeofday(&tv, NULL);
-    return tv.tv_sec + tv.tv_usec / 1000000.0;
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
 }
 
-static bool timer_enabled;
-static std::vector<std::pair<std::string, double> > timers;
+// Phase timers. Every rank records all phases. timer_next() ends the current
+// top-level phase and starts the next one, while a scoped_timer measures a
+// phase nested in the current one for its lifetime. timer_end() collects the
+// durations of all ranks and the master prints min/mean/max per phase, plus
+// the rank that took the longest. The memory usage at the end of every phase
+// is printed for the rank using the most memory. If hardware counters are
+// enabled, the counters of every phase are summed over all ranks as well.
+struct timer_phase {
+    std::string name;
+    size_t depth;
+    double start;
+    double end;
+
+    // Counter values at the start of the phase, and the difference once ended
+    perf::sample counters;
+
+    // Memory usage when the phase ended
+    memory::usage memory;
+};
 
-static void timer_start(bool enabled=true) {
+static std::vector<timer_phase> timers;
+static std::vector<size_t> timers_open;
+
+static void timer_start() {
     timers.clear();
-    timer_enabled = enabled;
+    timers_open.clear();
 }
 
-static void timer_next(std::string name) {
-    if (timer_enabled) {
-        timers.push_back(std::make_pair(name, timer()));
+// Ends all open phases at the given depth or deeper
+static void timer_close(size_t depth) {
+    double now = timer();
+    perf::sample counters = perf::enabled() ? perf::read() : perf::sample();
+    memory::usage memory = memory::current();
+
+    while (timers_open.size() > depth) {
+        timer_phase &phase = timers[timers_open.back()];
+        perf::sample start = phase.counters;
+
+        phase.end = now;
+        phase.counters = counters;
+        phase.counters -= start;
+        phase.memory = memory;
+        timers_open.pop_back();
     }
 }
 
-static void timer_end() {
-    if (timer_enabled) {
-        timer_next("end");
+static void timer_open(const std::string &name) {
+    timer_phase phase;
+    phase.name = name;
+    phase.depth = timers_open.size();
+    phase.start = timer();
+    phase.end = phase.start;
+    phase.counters = perf::enabled() ? perf::read() : perf::sample();
+
+    timers_open.push_back(timers.size());
+    timers.push_back(phase);
+}
 
-        std::cerr << "Timing results:" << std::endl;
+static void timer_next(std::string name) {
+    timer_close(0);
+    timer_open(name);
+}
 
-        for (size_t i = 0; i < timers.size() - 1; i++) {
-            std::string &name = timers[i].first;
-            double time = timers[i + 1].second - timers[i].second;
+class scoped_timer {
+    public:
+        scoped_timer(const std::string &name) {
+            depth = timers_open.size();
+            timer_open(name);
+        }
 
-            std::cerr << " - "  << name << ": " << time << " sec" <<  std::endl;
+        ~scoped_timer() {
+            timer_close(depth);
         }
 
-        timers.clear();
+    private:
+        size_t depth;
+};
+
+static void timer_end(graphlab::distributed_control &dc) {
+    timer_close(0);
+
+    // All ranks execute the same phases, so they can be matched by position
+    std::vector<std::vector<double> > durations(dc.numprocs());
+    std::vector<std::vector<perf::sample> > counters(dc.numprocs());
+    std::vector<std::vector<memory::usage> > memory(dc.numprocs());
+
+    for (size_t i = 0; i < timers.size(); i++) {
+        durations[dc.procid()].push_back(timers[i].end - timers[i].start);
+        counters[dc.procid()].push_back(timers[i].counters);
+        memory[dc.procid()].push_back(timers[i].memory);
     }
+
+    dc.all_gather(durations);
+    dc.all_gather(memory);
+
+    if (perf::enabled()) {
+        dc.all_gather(counters);
+    }
+
+    if (dc.procid() == 0) {
+        std::vector<double> min_time(timers.size()), mean_time(timers.size()), max_time(timers.size());
+        std::vector<size_t> max_rank(timers.size());
+        std::vector<perf::sample> total_counters(timers.size());
+        std::vector<memory::usage> max_memory(timers.size());
+        std::vector<size_t> max_memory_rank(timers.size());
+
+        for (size_t i = 0; i < timers.size(); i++) {
+            min_time[i] = max_time[i] = durations[0][i];
+
+            for (size_t r = 0; r < durations.size(); r++) {
+                double time = durations[r][i];
+
+                if (perf::enabled()) {
+                    total_counters[i] += counters[r][i];
+                }
+
+                const memory::usage &m = memory[r][i];
+
+                if (m.peak_rss > max_memory[i].peak_rss) {
+                    max_memory[i].peak_rss = m.peak_rss;
+                    max_memory_rank[i] = r;
+                }
+
+                max_memory[i].rss = std::max(max_memory[i].rss, m.rss);
+                max_memory[i].heap = std::max(max_memory[i].heap, m.heap);
+                max_memory[i].allocated = std::max(max_memory[i].allocated, m.allocated);
+
+                mean_time[i] += time / durations.size();
+                min_time[i] = std::min(min_time[i], time);
+
+                if (time > max_time[i]) {
+                    max_time[i] = time;
+                    max_rank[i] = r;
+                }
+            }
+        }
+
+        std::cerr << "Timing results (slowest of " << dc.numprocs() << " ranks):" << std::endl;
+
+        for (size_t i = 0; i < timers.size(); i++) {
+            std::cerr << std::string(2 * timers[i].depth, ' ') << " - " << timers[i].name << ": "
+                      << max_time[i] << " sec (min " << min_time[i] << ", mean " << mean_time[i]
+                      << ", slowest rank " << max_rank[i] << ")" << std::endl;
+        }
+
+        std::cerr << "Memory usage at the end of each phase (maximum over all ranks):" << std::endl;
+
+        for (size_t i = 0; i < timers.size(); i++) {
+            const memory::usage &m = max_memory[i];
+
+            std::cerr << std::string(2 * timers[i].depth, ' ') << " - " << timers[i].name << ": "
+                      << "peak RSS " << m.peak_rss / (1024 * 1024) << " MB (rank " << max_memory_rank[i] << "), "
+                      << "RSS " << m.rss / (1024 * 1024) << " MB, "
+                      << "heap " << m.heap / (1024 * 1024) << " MB, "
+                      << "allocated " << m.allocated / (1024 * 1024) << " MB" << std::endl;
+        }
+
+        if (perf::enabled()) {
+            std::cerr << "Hardware counters (summed over " << dc.numprocs() << " ranks):" << std::endl;
+
+            for (size_t i = 0; i < timers.size(); i++) {
+                std::cerr << std::string(2 * timers[i].depth, ' ') << " - " << timers[i].name << ": ";
+                perf::write_text(std::cerr, total_counters[i]);
+                std::cerr << std::endl;
+            }
+        }
+
+        // The same results as JSON records, which are parsed by the driver
+        for (size_t i = 0; i < timers.size(); i++) {
+            std::cerr << "{\"type\":\"phase\",\"name\":\"" << timers[i].name << "\""
+                      << ",\"depth\":" << timers[i].depth
+                      << ",\"time_sec\":" << max_time[i]
+                      << ",\"min_sec\":" << min_time[i]
+                      << ",\"mean_sec\":" << mean_time[i]
+                      << ",\"max_sec\":" << max_time[i]
+                      << ",\"slowest_rank\":" << max_rank[i]
+                      << ",\"peak_rss_bytes\":" << max_memory[i].peak_rss
+                      << ",\"peak_rss_rank\":" << max_memory_rank[i]
+                      << ",\"rss_bytes\":" << max_memory[i].rss
+                      << ",\"heap_bytes\":" << max_memory[i].heap
+                      << ",\"allocated_bytes\":" << max_memory[i].allocated;
+
+            if (perf::enabled()) {
+                perf::write_json(std::cerr, total_counters[i]);
+            }
+
+            std::cerr << "}" << std::endl;
+        }
+    }
+
+    timers.clear();
+    timers_open.clear();
 }
 
 #endif
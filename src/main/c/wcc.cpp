@@ -18,6 +18,8 @@
 
 #include "algorithms.hpp"
 #include "utils.hpp"
+#include "metrics.hpp"
+#include "incremental.hpp"
 
 #ifdef GRANULA
 #include "granula.hpp"
@@ -37,6 +39,32 @@ typedef graphlab::distributed_graph<vertex_data_type, edge_data_type> graph_type
 
 const vertex_data_type INVALID_LABEL = numeric_limits<vertex_data_type>::max();
 
+static void init_vertex(graph_type::vertex_type &vertex) {
+    vertex.data() = vertex.id();
+}
+
+// Incremental runs start from the labels of the previous run. A deleted edge
+// may split its component, so the vertices of components with a deleted edge
+// start over from their own id, like vertices that did not exist before.
+// Inserted edges can only merge components, so their endpoints scatter their
+// label again.
+typedef incremental::prior_result<vertex_data_type> prior_type;
+
+static void init_prior(graph_type::vertex_type &vertex, const prior_type &prior,
+                       const boost::unordered_set<vertex_data_type> &split_labels) {
+
+    vertex_data_type label = prior.get(vertex.id(), INVALID_LABEL);
+    vertex.data() = label == INVALID_LABEL || split_labels.count(label) > 0 ? vertex.id() : label;
+}
+
+static bool is_seed(const graph_type::vertex_type &vertex, const prior_type &prior,
+                    const boost::unordered_set<vertex_data_type> &split_labels,
+                    const boost::unordered_set<graphlab::vertex_id_type> &endpoints) {
+
+    vertex_data_type label = prior.get(vertex.id(), INVALID_LABEL);
+    return label == INVALID_LABEL || split_labels.count(label) > 0 || endpoints.count(vertex.id()) > 0;
+}
+
 class weakly_connected_components :
     public graphlab::ivertex_program<graph_type, gather_type, msg_type>,
     public graphlab::IS_POD_TYPE {
@@ -54,10 +82,10 @@ class weakly_connected_components :
         }
 
         void apply(icontext_type& context, vertex_type& vertex, const gather_type &total) {
-            // First iteration, set label to vertex id
+            // First iteration, or a vertex affected by edge updates in an
+            // incremental run: scatter the current label
             if (last_msg.get() == INVALID_LABEL) {
                 changed = true;
-                vertex.data() = vertex.id();
             }
 
             // Neighbor updated, if label of neighbor is lower -> change label
@@ -89,7 +117,7 @@ class weakly_connected_components :
 
 void run(context_t &ctx, string job_id) {
     bool is_master = ctx.dc.procid() == 0;
-    timer_start(is_master);
+    timer_start();
 
 #ifdef GRANULA
     granula::startMonitorProcess(getpid());
@@ -104,12 +132,44 @@ void run(context_t &ctx, string job_id) {
     granula::linkProcess(getpid(), job_id);
 #endif
 
+    // check memory budget
+    size_t memory_estimate = memory::estimate(ctx,
+            sizeof(vertex_data_type) + sizeof(weakly_connected_components) + sizeof(msg_type), sizeof(edge_data_type));
+
+    if (memory::exceeds_budget(ctx, "wcc", memory_estimate)) {
+        memory::abort_over_budget(ctx);
+    }
+
     // load graph
     timer_next("load graph");
     graph_type graph(ctx.dc);
     load_graph(graph, ctx);
     graph.finalize();
 
+    graphlab::vertex_set seeds;
+    bool incremental = !ctx.prior_result.empty();
+
+    if (incremental) {
+        prior_type prior;
+        prior.read(ctx, graph);
+
+        boost::unordered_set<vertex_data_type> split_labels;
+        boost::unordered_set<graphlab::vertex_id_type> endpoints = prior.inserted_endpoints(false);
+
+        for (size_t i = 0; i < prior.updates.size(); i++) {
+            if (!prior.updates[i].inserted) {
+                split_labels.insert(prior.get(prior.updates[i].source, INVALID_LABEL));
+            }
+        }
+
+        graph.transform_vertices(boost::bind(init_prior, _1, boost::cref(prior), boost::cref(split_labels)));
+        seeds = graph.select(boost::bind(is_seed, _1, boost::cref(prior),
+                                           boost::cref(split_labels), boost::cref(endpoints)));
+        incremental::report_seeds(graph, seeds);
+    } else {
+        graph.transform_vertices(init_vertex);
+    }
+
 #ifdef GRANULA
     if(is_master) {
         cout<<loadGraph.getOperationInfo("EndTime", loadGraph.getEpoch())<<endl;
@@ -118,8 +178,13 @@ void run(context_t &ctx, string job_id) {
 
     // run engine
     timer_next("initialize engine");
-    graphlab::omni_engine<weakly_connected_components> engine(ctx.dc, graph, "synchronous", ctx.clopts);
-    engine.signal_all(msg_type(INVALID_LABEL));
+    graphlab::omni_engine<metrics::instrumented<weakly_connected_components> > engine(ctx.dc, graph, "synchronous", ctx.clopts);
+
+    if (incremental) {
+        engine.signal_vset(seeds, msg_type(INVALID_LABEL));
+    } else {
+        engine.signal_all(msg_type(INVALID_LABEL));
+    }
 
 #ifdef GRANULA
     granula::operation processGraph("PowerGraph", "Id.Unique", "ProcessGraph", "Id.Unique");
@@ -130,7 +195,9 @@ void run(context_t &ctx, string job_id) {
 
     // run algorithm
     timer_next("run algorithm");
+    metrics::begin_run(ctx.dc);
     engine.start();
+    metrics::end_run(ctx.dc);
 
 #ifdef GRANULA
     if(is_master) {
@@ -156,7 +223,8 @@ void run(context_t &ctx, string job_id) {
         }
     }
 
-    timer_end();
+    timer_end(ctx.dc);
+    metrics::report(ctx.dc, "wcc");
 
 #ifdef GRANULA
     if(is_master) {
@@ -34,6 +34,8 @@ abstract public class PowergraphJob {
 	private String edgesPath;
 	private boolean graphDirected;
 	private File outputFile;
+	private long numVertices;
+	private long numEdges;
 	private Configuration config;
 	private String logPath;
 
@@ -52,6 +54,11 @@ abstract public class PowergraphJob {
 		outputFile = file;
 	}
 
+	public void setGraphSize(long numVertices, long numEdges) {
+		this.numVertices = numVertices;
+		this.numEdges = numEdges;
+	}
+
 	public void run() throws IOException, InterruptedException {
 		List<String> args = new ArrayList<>();
 		args.add(verticesPath);
@@ -64,6 +71,20 @@ abstract public class PowergraphJob {
 			args.add(outputFile.getAbsolutePath());
 		}
 
+		if (numVertices > 0 && numEdges > 0) {
+			args.add("--num-vertices");
+			args.add(String.valueOf(numVertices));
+			args.add("--num-edges");
+			args.add(String.valueOf(numEdges));
+		}
+
+		int memoryBudget = config.getInt("platform.powergraph.memory-budget", -1);
+
+		if (memoryBudget > 0) {
+			args.add("--memory-budget");
+			args.add(String.valueOf(memoryBudget));
+		}
+
 		int numThreads = config.getInt("platform.powergraph.num-threads", -1);
 
 		if (numThreads > 0) {
@@ -71,6 +92,32 @@ abstract public class PowergraphJob {
 			args.add(String.valueOf(numThreads));
 		}
 
+		String backend = config.getString("platform.powergraph.backend", "engine");
+
+		if (!backend.equals("engine")) {
+			args.add("--backend");
+			args.add(backend);
+		}
+
+		if (config.getBoolean("platform.powergraph.superstep-metrics", false)) {
+			args.add("--superstep-metrics");
+			args.add("1");
+		}
+
+		if (config.getBoolean("platform.powergraph.compress-payloads", false)) {
+			args.add("--compress-payloads");
+			args.add("1");
+		}
+
+		// Further options of main, e.g. to select a variant of an algorithm
+		for (String value: config.getStringArray("platform.powergraph.args")) {
+			for (String arg: value.trim().split("\\s+")) {
+				if (!arg.isEmpty()) {
+					args.add(arg);
+				}
+			}
+		}
+
 		args.add("--job-id");
 		args.add(jobId);
 
@@ -87,6 +134,8 @@ abstract public class PowergraphJob {
 
 		ProcessBuilder pb = new ProcessBuilder(cmd.split(" "));
 		pb.redirectErrorStream(true);
+		pb.environment().put("POWERGRAPH_PLACEMENT", config.getString("platform.powergraph.placement", "node"));
+		pb.environment().put("POWERGRAPH_SOCKETS_PER_NODE", String.valueOf(config.getInt("platform.powergraph.sockets-per-node", 2)));
 
 
 		Process process = pb.start();
@@ -28,8 +28,6 @@ import java.nio.file.SimpleFileVisitor;
 import java.nio.file.attribute.BasicFileAttributes;
 import java.util.ArrayList;
 import java.util.List;
-import java.util.regex.Matcher;
-import java.util.regex.Pattern;
 
 import science.atlarge.granula.archiver.PlatformArchive;
 import science.atlarge.granula.modeller.job.JobModel;
@@ -65,7 +63,10 @@ import science.atlarge.graphalytics.powergraph.algorithms.wcc.ConnectedComponent
 import science.atlarge.graphalytics.powergraph.algorithms.pr.PageRankJob;
 import science.atlarge.graphalytics.powergraph.algorithms.sssp.SingleSourceShortestPathsJob;
 import science.atlarge.graphalytics.powergraph.algorithms.lcc.LocalClusteringCoefficientJob;
+import org.json.simple.JSONArray;
 import org.json.simple.JSONObject;
+import org.json.simple.parser.JSONParser;
+import org.json.simple.parser.ParseException;
 
 /**
  * PowerGraph implementation of the Graphalytics benchmark.
@@ -168,6 +169,9 @@ public class PowergraphPlatform implements GranulaAwarePlatform {
 				throw new PlatformExecutionException("Unsupported algorithm");
 		}
 
+		FormattedGraph formattedGraph = benchmarkRun.getFormattedGraph();
+		job.setGraphSize(formattedGraph.getNumberOfVertices(), formattedGraph.getNumberOfEdges());
+
 		if (benchmarkRunSetup.isOutputRequired()) {
 			Path outputFile = benchmarkRunSetup.getOutputDir().resolve(benchmarkRun.getName());
 			job.setOutputFile(outputFile.toFile());
@@ -197,7 +201,8 @@ public class PowergraphPlatform implements GranulaAwarePlatform {
 
 		Path platformLogPath = benchmarkRunSetup.getLogDir().resolve("platform");
 
-		final List<Double> superstepTimes = new ArrayList<>();
+		final List<Double> processingTimes = new ArrayList<>();
+		final List<JSONObject> supersteps = new ArrayList<>();
 
 		try {
 			Files.walkFileTree(platformLogPath, new SimpleFileVisitor<Path>() {
@@ -205,12 +210,16 @@ public class PowergraphPlatform implements GranulaAwarePlatform {
 				public FileVisitResult visitFile(Path file, BasicFileAttributes attrs) throws IOException {
 					String logs = FileUtil.readFile(file);
 					for (String line : logs.split("\n")) {
-						if (line.contains("- run algorithm:")) {
-							Pattern regex = Pattern.compile(
-									".* - run algorithm: ([+-]?([0-9]*[.])?[0-9]+) sec.*");
-							Matcher matcher = regex.matcher(line);
-							matcher.find();
-							superstepTimes.add(Double.parseDouble(matcher.group(1)));
+						JSONObject record = parseMetricsRecord(line);
+
+						if (record == null) {
+							continue;
+						}
+
+						if ("phase".equals(record.get("type")) && "run algorithm".equals(record.get("name"))) {
+							processingTimes.add(((Number) record.get("time_sec")).doubleValue());
+						} else if ("superstep".equals(record.get("type"))) {
+							supersteps.add(record);
 						}
 					}
 					return FileVisitResult.CONTINUE;
@@ -220,10 +229,14 @@ public class PowergraphPlatform implements GranulaAwarePlatform {
 			e.printStackTrace();
 		}
 
-		if (superstepTimes.size() != 0) {
+		if (!supersteps.isEmpty()) {
+			logSuperstepSummary(supersteps);
+		}
+
+		if (processingTimes.size() != 0) {
 			Double procTime = 0.0;
-			for (Double superstepTime : superstepTimes) {
-				procTime += superstepTime;
+			for (Double processingTime : processingTimes) {
+				procTime += processingTime;
 			}
 
 			BenchmarkMetrics metrics = new BenchmarkMetrics();
@@ -232,11 +245,53 @@ public class PowergraphPlatform implements GranulaAwarePlatform {
 
 			return metrics;
 		} else {
-			LOG.error("Failed to find any metrics regarding superstep runtime.");
+			LOG.error("Failed to find any metrics regarding processing time.");
 			return new BenchmarkMetrics();
 		}
 	}
 
+	/**
+	 * Parses a JSON metrics record written by the platform binary, or returns null if the line is not one.
+	 */
+	private static JSONObject parseMetricsRecord(String line) {
+		int start = line.indexOf("{\"type\":");
+
+		if (start < 0) {
+			return null;
+		}
+
+		try {
+			Object record = new JSONParser().parse(line.substring(start));
+			return record instanceof JSONObject ? (JSONObject) record : null;
+		} catch (ParseException e) {
+			LOG.warn("Failed to parse metrics record: " + line);
+			return null;
+		}
+	}
+
+	private static void logSuperstepSummary(List<JSONObject> supersteps) {
+		long messages = 0;
+		JSONObject slowest = null;
+		double slowestTime = -1.0;
+
+		for (JSONObject superstep : supersteps) {
+			messages += ((Number) superstep.get("messages")).longValue();
+
+			double time = 0.0;
+			for (Object rankTime : (JSONArray) superstep.get("time_sec")) {
+				time = Math.max(time, ((Number) rankTime).doubleValue());
+			}
+
+			if (time > slowestTime) {
+				slowestTime = time;
+				slowest = superstep;
+			}
+		}
+
+		LOG.info(String.format("Executed %d supersteps, sending %d messages. Slowest superstep: %s (%.3f s).",
+				supersteps.size(), messages, slowest.get("superstep"), slowestTime));
+	}
+
 	@Override
 	public void enrichMetrics(BenchmarkRunResult benchmarkRunResult, Path arcDirectory) {
 		try {
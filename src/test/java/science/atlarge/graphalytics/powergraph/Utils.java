@@ -87,4 +87,16 @@ public class Utils {
 			return new PropertiesConfiguration();
 		}
 	}
+
+	public static Configuration loadConfiguration(String backend) {
+		Configuration config = loadConfiguration();
+		config.setProperty("platform.powergraph.backend", backend);
+		return config;
+	}
+
+	public static Configuration loadConfigurationWithArgs(String args) {
+		Configuration config = loadConfiguration();
+		config.setProperty("platform.powergraph.args", args);
+		return config;
+	}
 }
@@ -17,6 +17,8 @@ package science.atlarge.graphalytics.powergraph.algorithms.bfs;
 
 import java.io.File;
 
+import org.apache.commons.configuration.Configuration;
+
 import science.atlarge.graphalytics.domain.algorithms.BreadthFirstSearchParameters;
 import science.atlarge.graphalytics.powergraph.Utils;
 import science.atlarge.graphalytics.validation.GraphStructure;
@@ -42,6 +44,10 @@ public class BreadthFirstSearchJobTestIT extends BreadthFirstSearchValidationTes
 		return execute(graph, parameters, false);
 	}
 	
+	protected Configuration loadConfiguration() {
+		return Utils.loadConfiguration();
+	}
+
 	private BreadthFirstSearchOutput execute(GraphStructure graph,
 			BreadthFirstSearchParameters parameters, boolean directed) throws Exception {
 		File edgesFile = File.createTempFile("edges.", ".txt");
@@ -55,7 +61,7 @@ public class BreadthFirstSearchJobTestIT extends BreadthFirstSearchValidationTes
 		String logPath = "RandomLogDir";
 
 		BreadthFirstSearchJob job = new BreadthFirstSearchJob(
-				Utils.loadConfiguration(),
+				loadConfiguration(),
 				verticesFile.getAbsolutePath(), edgesFile.getAbsolutePath(),
 				directed, parameters, jobId, logPath);
 		job.setOutputFile(outputFile);
@@ -0,0 +1,32 @@
+/*
+ * Copyright 2015 Delft University of Technology
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+package science.atlarge.graphalytics.powergraph.algorithms.bfs;
+
+import org.apache.commons.configuration.Configuration;
+
+import science.atlarge.graphalytics.powergraph.Utils;
+
+/**
+ * Runs the validation tests of {@link BreadthFirstSearchJobTestIT} on the shared-memory backend.
+ */
+public class BreadthFirstSearchShmJobTestIT extends BreadthFirstSearchJobTestIT {
+
+	@Override
+	protected Configuration loadConfiguration() {
+		return Utils.loadConfiguration("shm");
+	}
+
+}
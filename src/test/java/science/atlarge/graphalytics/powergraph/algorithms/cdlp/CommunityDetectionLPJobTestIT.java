@@ -17,6 +17,8 @@ package science.atlarge.graphalytics.powergraph.algorithms.cdlp;
 
 import java.io.File;
 
+import org.apache.commons.configuration.Configuration;
+
 import science.atlarge.graphalytics.domain.algorithms.CommunityDetectionLPParameters;
 import science.atlarge.graphalytics.powergraph.Utils;
 import science.atlarge.graphalytics.validation.GraphStructure;
@@ -42,6 +44,10 @@ public class CommunityDetectionLPJobTestIT extends CommunityDetectionLPValidatio
 		return execute(graph, parameters, false);
 	}
 	
+	protected Configuration loadConfiguration() {
+		return Utils.loadConfiguration();
+	}
+
 	private CommunityDetectionLPOutput execute(GraphStructure graph, CommunityDetectionLPParameters parameters,
 			boolean directed) throws Exception {
 		File edgesFile = File.createTempFile("edges.", ".txt");
@@ -55,7 +61,7 @@ public class CommunityDetectionLPJobTestIT extends CommunityDetectionLPValidatio
 		String logPath = "RandomLogDir";
 
 		CommunityDetectionJob job = new CommunityDetectionJob(
-				Utils.loadConfiguration(),
+				loadConfiguration(),
 				verticesFile.getAbsolutePath(), edgesFile.getAbsolutePath(),
 				directed, parameters, jobId, logPath);
 		job.setOutputFile(outputFile);
@@ -0,0 +1,188 @@
+/*
+ * Copyright 2015 Delft University of Technology
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+package science.atlarge.graphalytics.powergraph.algorithms.lcc;
+
+import static org.junit.Assert.assertEquals;
+import static org.junit.Assert.assertTrue;
+
+import java.io.BufferedWriter;
+import java.io.File;
+import java.io.FileWriter;
+import java.util.HashMap;
+import java.util.HashSet;
+import java.util.Map;
+import java.util.Random;
+import java.util.Set;
+
+import org.junit.Test;
+
+import science.atlarge.graphalytics.powergraph.Utils;
+
+/**
+ * Tests the approximate variant of the local clustering coefficient (--lcc-approximate) on a generated graph with a
+ * skewed degree distribution. Vertices with at most SAMPLES edges must get their exact coefficient. The others get a
+ * 95% confidence interval, which must contain the exact coefficient for at least MIN_COVERAGE of them. The neighbors
+ * are sampled by a hash of the ids, so the result does not change between runs.
+ */
+public class LocalClusteringCoefficientApproximateJobTestIT {
+
+	private static final int NUM_VERTICES = 2000;
+	private static final int EDGES_PER_VERTEX = 8;
+	private static final long SEED = 42;
+	private static final int SAMPLES = 32;
+	private static final double MIN_COVERAGE = 0.85;
+	private static final double EPSILON = 1e-5;
+
+	@Test
+	public void testDirectedApproximateLocalClusteringCoefficient() throws Exception {
+		test(true);
+	}
+
+	@Test
+	public void testUndirectedApproximateLocalClusteringCoefficient() throws Exception {
+		test(false);
+	}
+
+	private void test(boolean directed) throws Exception {
+		Map<Long, Set<Long>> edges = generateGraph(directed);
+		Map<Long, Set<Long>> successors = new HashMap<>();
+		Map<Long, Set<Long>> neighbors = new HashMap<>();
+		Map<Long, Integer> numEdges = new HashMap<>();
+
+		for (long v = 0; v < NUM_VERTICES; v++) {
+			successors.put(v, new HashSet<Long>());
+			neighbors.put(v, new HashSet<Long>());
+			numEdges.put(v, 0);
+		}
+
+		for (long v = 0; v < NUM_VERTICES; v++) {
+			for (long u: edges.get(v)) {
+				successors.get(v).add(u);
+				if (!directed) successors.get(u).add(v);
+				neighbors.get(v).add(u);
+				neighbors.get(u).add(v);
+				numEdges.put(v, numEdges.get(v) + 1);
+				numEdges.put(u, numEdges.get(u) + 1);
+			}
+		}
+
+		Map<Long, String> results = execute(edges, directed);
+		int sampled = 0;
+		int covered = 0;
+
+		for (long v = 0; v < NUM_VERTICES; v++) {
+			String[] values = results.get(v).split(" ");
+			assertEquals("values of vertex " + v, 3, values.length);
+
+			double value = Double.parseDouble(values[0]);
+			double low = Double.parseDouble(values[1]);
+			double high = Double.parseDouble(values[2]);
+			double exact = exactCoefficient(v, successors, neighbors);
+
+			if (numEdges.get(v) <= SAMPLES) {
+				assertEquals("coefficient of vertex " + v, exact, value, EPSILON);
+			} else {
+				sampled++;
+
+				if (low - EPSILON <= exact && exact <= high + EPSILON) {
+					covered++;
+				}
+			}
+		}
+
+		assertTrue("no vertex has more than " + SAMPLES + " edges", sampled > 0);
+		assertTrue(covered + " of " + sampled + " intervals contain the exact coefficient",
+				covered >= MIN_COVERAGE * sampled);
+	}
+
+	// Every vertex gets edges to EDGES_PER_VERTEX random vertices, biased towards low ids. Undirected edges are
+	// stored once, from the lower id.
+	private static Map<Long, Set<Long>> generateGraph(boolean directed) {
+		Random random = new Random(SEED);
+		Map<Long, Set<Long>> edges = new HashMap<>();
+
+		for (long v = 0; v < NUM_VERTICES; v++) {
+			edges.put(v, new HashSet<Long>());
+		}
+
+		for (long v = 0; v < NUM_VERTICES; v++) {
+			for (int i = 0; i < EDGES_PER_VERTEX; i++) {
+				double r = random.nextDouble();
+				long u = (long) (NUM_VERTICES * r * r);
+
+				if (u != v) {
+					edges.get(directed ? v : Math.min(u, v)).add(directed ? u : Math.max(u, v));
+				}
+			}
+		}
+
+		return edges;
+	}
+
+	// Edges between the neighbors of v, divided by the number of ordered pairs of neighbors
+	private static double exactCoefficient(long v, Map<Long, Set<Long>> successors, Map<Long, Set<Long>> neighbors) {
+		Set<Long> n = neighbors.get(v);
+		long d = n.size();
+		long count = 0;
+
+		if (d < 2) {
+			return 0.0;
+		}
+
+		for (long u: n) {
+			for (long w: successors.get(u)) {
+				if (n.contains(w)) {
+					count++;
+				}
+			}
+		}
+
+		return (double) count / (d * (d - 1));
+	}
+
+	private Map<Long, String> execute(Map<Long, Set<Long>> edges, boolean directed) throws Exception {
+		File edgesFile = File.createTempFile("edges.", ".txt");
+		File verticesFile = File.createTempFile("vertices.", ".txt");
+		File outputFile = File.createTempFile("output.", ".txt");
+
+		BufferedWriter w = new BufferedWriter(new FileWriter(verticesFile));
+
+		for (long v = 0; v < NUM_VERTICES; v++) {
+			w.write(String.format("%d\n", v));
+		}
+
+		w.close();
+		w = new BufferedWriter(new FileWriter(edgesFile));
+
+		for (long v = 0; v < NUM_VERTICES; v++) {
+			for (long u: edges.get(v)) {
+				w.write(String.format("%d %d\n", v, u));
+			}
+		}
+
+		w.close();
+
+		LocalClusteringCoefficientJob job = new LocalClusteringCoefficientJob(
+				Utils.loadConfigurationWithArgs("--lcc-approximate 1 --lcc-samples " + SAMPLES),
+				verticesFile.getAbsolutePath(), edgesFile.getAbsolutePath(),
+				directed, "RandomJobId", "RandomLogDir");
+		job.setOutputFile(outputFile);
+		job.run();
+
+		return Utils.readResults(outputFile, String.class);
+	}
+
+}
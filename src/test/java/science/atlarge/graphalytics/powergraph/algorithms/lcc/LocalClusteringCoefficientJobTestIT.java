@@ -17,6 +17,8 @@ package science.atlarge.graphalytics.powergraph.algorithms.lcc;
 
 import java.io.File;
 
+import org.apache.commons.configuration.Configuration;
+
 import science.atlarge.graphalytics.powergraph.Utils;
 import science.atlarge.graphalytics.validation.GraphStructure;
 import science.atlarge.graphalytics.validation.algorithms.lcc.LocalClusteringCoefficientOutput;
@@ -41,6 +43,10 @@ public class LocalClusteringCoefficientJobTestIT extends LocalClusteringCoeffici
 		return execute(graph, false);
 	}
 	
+	protected Configuration loadConfiguration() {
+		return Utils.loadConfiguration();
+	}
+
 	private LocalClusteringCoefficientOutput execute(GraphStructure graph, boolean directed) throws Exception {
 		File edgesFile = File.createTempFile("edges.", ".txt");
 		File verticesFile = File.createTempFile("vertices.", ".txt");
@@ -53,7 +59,7 @@ public class LocalClusteringCoefficientJobTestIT extends LocalClusteringCoeffici
 		String logPath = "RandomLogDir";
 
 		LocalClusteringCoefficientJob job = new LocalClusteringCoefficientJob(
-				Utils.loadConfiguration(),
+				loadConfiguration(),
 				verticesFile.getAbsolutePath(), edgesFile.getAbsolutePath(),
 				directed, jobId, logPath);
 		job.setOutputFile(outputFile);
@@ -0,0 +1,34 @@
+/*
+ * Copyright 2015 Delft University of Technology
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+package science.atlarge.graphalytics.powergraph.algorithms.lcc;
+
+import org.apache.commons.configuration.Configuration;
+
+import science.atlarge.graphalytics.powergraph.Utils;
+
+/**
+ * Runs the validation tests of {@link LocalClusteringCoefficientJobTestIT} on the memory-bounded variant, which
+ * counts the triangles in rounds over partitions of the neighbor lists. The small validation graphs fit in any memory
+ * budget, so the number of rounds is set directly.
+ */
+public class LocalClusteringCoefficientRoundsJobTestIT extends LocalClusteringCoefficientJobTestIT {
+
+	@Override
+	protected Configuration loadConfiguration() {
+		return Utils.loadConfigurationWithArgs("--lcc-rounds 3");
+	}
+
+}
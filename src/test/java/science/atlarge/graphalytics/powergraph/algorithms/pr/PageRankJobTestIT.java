@@ -17,6 +17,8 @@ package science.atlarge.graphalytics.powergraph.algorithms.pr;
 
 import java.io.File;
 
+import org.apache.commons.configuration.Configuration;
+
 import science.atlarge.graphalytics.domain.algorithms.PageRankParameters;
 import science.atlarge.graphalytics.powergraph.Utils;
 import science.atlarge.graphalytics.validation.GraphStructure;
@@ -42,6 +44,10 @@ public class PageRankJobTestIT extends PageRankValidationTest {
 		return execute(graph, parameters, false);
 	}
 	
+	protected Configuration loadConfiguration() {
+		return Utils.loadConfiguration();
+	}
+
 	private PageRankOutput execute(GraphStructure graph, PageRankParameters parameters, boolean directed)
 			throws Exception {
 		File edgesFile = File.createTempFile("edges.", ".txt");
@@ -55,7 +61,7 @@ public class PageRankJobTestIT extends PageRankValidationTest {
 		String logPath = "RandomLogDir";
 
 		PageRankJob job = new PageRankJob(
-				Utils.loadConfiguration(),
+				loadConfiguration(),
 				verticesFile.getAbsolutePath(), edgesFile.getAbsolutePath(),
 				directed, parameters, jobId, logPath);
 		job.setOutputFile(outputFile);
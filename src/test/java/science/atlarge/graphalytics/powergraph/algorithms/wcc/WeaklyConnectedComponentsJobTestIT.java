@@ -17,6 +17,8 @@ package science.atlarge.graphalytics.powergraph.algorithms.wcc;
 
 import java.io.File;
 
+import org.apache.commons.configuration.Configuration;
+
 import science.atlarge.graphalytics.powergraph.Utils;
 import science.atlarge.graphalytics.validation.GraphStructure;
 import science.atlarge.graphalytics.validation.algorithms.wcc.WeaklyConnectedComponentsOutput;
@@ -39,6 +41,10 @@ public class WeaklyConnectedComponentsJobTestIT extends WeaklyConnectedComponent
 		return execute(graph, false);
 	}
 	
+	protected Configuration loadConfiguration() {
+		return Utils.loadConfiguration();
+	}
+
 	private WeaklyConnectedComponentsOutput execute(GraphStructure graph, boolean directed) throws Exception {
 		File edgesFile = File.createTempFile("edges.", ".txt");
 		File verticesFile = File.createTempFile("vertices.", ".txt");
@@ -51,7 +57,7 @@ public class WeaklyConnectedComponentsJobTestIT extends WeaklyConnectedComponent
 		String logPath = "RandomLogDir";
 
 		ConnectedComponentsJob job = new ConnectedComponentsJob(
-				Utils.loadConfiguration(),
+				loadConfiguration(),
 				verticesFile.getAbsolutePath(), edgesFile.getAbsolutePath(),
 				directed, jobId, logPath);
 		job.setOutputFile(outputFile);